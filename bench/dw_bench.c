@@ -0,0 +1,169 @@
+// Directory walk benchmark: builds a synthetic font tree in a temporary
+// directory and times the old recursive opendir()/snprintf()/stat() walk
+// against dw.h and the cached font walk in ff.h.
+//
+//     make bench                     (or: build/dw_bench [file_count])
+
+#define _GNU_SOURCE
+#include <dirent.h>
+#include <errno.h>
+#include <ftw.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "../src/ff.h"
+
+#define BENCH_DEFAULT_FILE_COUNT 100000
+#define BENCH_FILES_PER_DIR 100
+#define BENCH_DIR_FANOUT 10
+#define BENCH_RUNS 5
+
+static double now_ms(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000.0 + ts.tv_nsec / 1e6;
+}
+
+// Leaf dirs at depth 3 (root/d0/d1/d2) holding BENCH_FILES_PER_DIR files,
+// every 10th of them a font.
+static size_t make_tree(const char* root, size_t file_count) {
+    char path[FF_PATH_MAX];
+    size_t made = 0;
+    for (size_t dir_index = 0; made < file_count; dir_index++) {
+        size_t d0 = dir_index / (BENCH_DIR_FANOUT * BENCH_DIR_FANOUT);
+        size_t d1 = (dir_index / BENCH_DIR_FANOUT) % BENCH_DIR_FANOUT;
+        size_t d2 = dir_index % BENCH_DIR_FANOUT;
+        snprintf(path, sizeof(path), "%s/d%zu", root, d0);
+        mkdir(path, 0755);
+        snprintf(path, sizeof(path), "%s/d%zu/d%zu", root, d0, d1);
+        mkdir(path, 0755);
+        snprintf(path, sizeof(path), "%s/d%zu/d%zu/d%zu", root, d0, d1, d2);
+        if (mkdir(path, 0755) != 0 && errno != EEXIST) {
+            perror(path);
+            exit(1);
+        }
+        for (size_t i = 0; i < BENCH_FILES_PER_DIR && made < file_count; i++, made++) {
+            char file_path[FF_PATH_MAX + 32];
+            snprintf(file_path, sizeof(file_path), "%s/file%zu.%s", path, i, i % 10 == 0 ? "ttf" : "txt");
+            FILE* file = fopen(file_path, "w");
+            if (!file) {
+                perror(file_path);
+                exit(1);
+            }
+            fclose(file);
+        }
+    }
+    return made;
+}
+
+static int remove_entry(const char* path, const struct stat* st, int type, struct FTW* ftw) {
+    (void)st, (void)type, (void)ftw;
+    return remove(path);
+}
+
+// The walk ff.h did before dw.h: a full path and a stat() per entry, recursion for subdirs.
+static void naive_walk(const char* path, size_t* fonts, size_t* stats) {
+    DIR* dir_stream = opendir(path);
+    if (!dir_stream)
+        return;
+    struct dirent* dir_entry;
+    struct stat file_st;
+    char some_full_path[FF_PATH_MAX];
+    while ((dir_entry = readdir(dir_stream))) {
+        if (strcmp(dir_entry->d_name, ".") == 0 || strcmp(dir_entry->d_name, "..") == 0)
+            continue;
+        snprintf(some_full_path, FF_PATH_MAX, "%s/%s", path, dir_entry->d_name);
+        (*stats)++;
+        if (stat(some_full_path, &file_st) != 0)
+            continue;
+        if (S_ISDIR(file_st.st_mode))
+            naive_walk(some_full_path, fonts, stats);
+        else if (S_ISREG(file_st.st_mode) && ffIsFontFile(dir_entry->d_name))
+            (*fonts)++;
+    }
+    closedir(dir_stream);
+}
+
+static int count_dw_font(const DW_Entry* entry, void* user) {
+    if (entry->type == DW_FILE && ffIsFontFile(entry->name))
+        (*(size_t*)user)++;
+    return DW_CONTINUE;
+}
+
+static int count_font(const char* font_path, void* user) {
+    (void)font_path;
+    (*(size_t*)user)++;
+    return 0;
+}
+
+static void report(const char* name, double best_ms, size_t files, size_t fonts, size_t stats) {
+    printf("%-22s %9.2f ms %12.0f entries/s %8zu fonts %8zu stat calls\n", name, best_ms, files / (best_ms / 1000.0), fonts, stats);
+}
+
+int main(int argc, char** argv) {
+    size_t file_count = argc > 1 ? strtoull(argv[1], NULL, 10) : BENCH_DEFAULT_FILE_COUNT;
+
+    char root[] = "/tmp/dw_bench_XXXXXX";
+    if (!mkdtemp(root)) {
+        perror("mkdtemp");
+        return 1;
+    }
+    printf("building %zu files under %s...\n", file_count, root);
+    make_tree(root, file_count);
+
+    FF_StringArray dirs;
+    ffStringArrayInit(&dirs, 0);
+    ffStringArrayAppend(&dirs, root);
+
+    double best = 1e30;
+    size_t fonts = 0, stats = 0;
+    for (int run = 0; run < BENCH_RUNS; run++) {
+        fonts = stats = 0;
+        double start = now_ms();
+        naive_walk(root, &fonts, &stats);
+        double elapsed = now_ms() - start;
+        best = elapsed < best ? elapsed : best;
+    }
+    report("opendir+stat", best, file_count, fonts, stats);
+
+    best = 1e30;
+    for (int run = 0; run < BENCH_RUNS; run++) {
+        fonts = 0;
+        DW_Walker walker;
+        dwInit(&walker, DW_FOLLOW_SYMLINKS, DW_DEFAULT_MAX_DEPTH);
+        dwPush(&walker, root, 0);
+        double start = now_ms();
+        dwRun(&walker, count_dw_font, &fonts);
+        double elapsed = now_ms() - start;
+        stats = walker.stat_calls;
+        dwDestroy(&walker);
+        best = elapsed < best ? elapsed : best;
+    }
+    report("dw.h", best, file_count, fonts, stats);
+
+    FF_FontCache cache;
+    ffFontCacheInit(&cache);
+    fonts = 0;
+    double start = now_ms();
+    ffFindFontsCached(&dirs, &cache, count_font, &fonts);
+    report("ff.h cold cache", now_ms() - start, file_count, fonts, 0);
+
+    best = 1e30;
+    for (int run = 0; run < BENCH_RUNS; run++) {
+        fonts = 0;
+        start = now_ms();
+        ffFindFontsCached(&dirs, &cache, count_font, &fonts);
+        double elapsed = now_ms() - start;
+        best = elapsed < best ? elapsed : best;
+    }
+    report("ff.h warm cache", best, file_count, fonts, 0);
+    ffFontCacheDestroy(&cache);
+    ffStringArrayDestroy(&dirs);
+
+    nftw(root, remove_entry, 64, FTW_DEPTH | FTW_PHYS);
+    return 0;
+}
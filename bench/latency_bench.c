@@ -0,0 +1,231 @@
+// Edit-to-pixel latency: runs froomf headless (SDL_VIDEODRIVER=offscreen or
+// dummy) with a generated config in a temporary $HOME, appends TODO lines to
+// its target file and times each append until the first presented frame that
+// includes the new entry, as reported through FROOMF_PRESENT_LOG.
+//
+//     make latency                   (or: build/latency_bench [-n iterations] [-d offscreen|dummy]
+//                                           [-f font family] [-x path/to/froomf])
+
+#define _GNU_SOURCE
+#include <errno.h>
+#include <fcntl.h>
+#include <ftw.h>
+#include <poll.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+#define BENCH_DEFAULT_ITERATIONS 200
+#define BENCH_DEFAULT_EXECUTABLE "build/froomf"
+#define BENCH_DEFAULT_VIDEO_DRIVER "offscreen"
+#define BENCH_DEFAULT_FONT_FAMILY "DejaVu Sans Mono"
+#define BENCH_STARTUP_TIMEOUT_MS 30000
+#define BENCH_FRAME_TIMEOUT_MS 5000
+#define BENCH_MIN_PAUSE_MS 20 // between appends, so the edits don't coalesce
+#define BENCH_MAX_PAUSE_MS 60
+
+static long long now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (long long)ts.tv_sec * 1000000000ll + ts.tv_nsec;
+}
+
+static int compare_long_long(const void* a, const void* b) {
+    long long x = *(const long long*)a, y = *(const long long*)b;
+    return (x > y) - (x < y);
+}
+
+static int remove_entry(const char* path, const struct stat* st, int type, struct FTW* ftw) {
+    (void)st, (void)type, (void)ftw;
+    return remove(path);
+}
+
+static void write_file(const char* path, const char* content, const char* mode) {
+    FILE* file = fopen(path, mode);
+    if (!file) {
+        perror(path);
+        exit(1);
+    }
+    fputs(content, file);
+    fclose(file);
+}
+
+// Present log reader: one "<ns> <entry count>" line per frame.
+typedef struct {
+    int fd;
+    char buffer[4096];
+    size_t used;
+} PresentLog;
+
+// Wait for a frame showing at least entry_count entries. Returns its
+// timestamp, or -1 on timeout or when froomf went away.
+static long long wait_for_frame(PresentLog* log, size_t entry_count, int timeout_ms) {
+    long long deadline = now_ns() + (long long)timeout_ms * 1000000ll;
+    while (1) {
+        char* newline;
+        while ((newline = memchr(log->buffer, '\n', log->used))) {
+            long long timestamp;
+            size_t count;
+            int parsed = sscanf(log->buffer, "%lld %zu", &timestamp, &count);
+            size_t line_length = newline - log->buffer + 1;
+            memmove(log->buffer, newline + 1, log->used - line_length);
+            log->used -= line_length;
+            if (parsed == 2 && count >= entry_count)
+                return timestamp;
+        }
+
+        long long left_ms = (deadline - now_ns()) / 1000000ll;
+        if (left_ms <= 0)
+            return -1;
+        struct pollfd pfd = {log->fd, POLLIN, 0};
+        if (poll(&pfd, 1, (int)left_ms) <= 0)
+            continue;
+        ssize_t got = read(log->fd, log->buffer + log->used, sizeof(log->buffer) - log->used);
+        if (got <= 0)
+            return -1;
+        log->used += (size_t)got;
+        if (log->used == sizeof(log->buffer)) // a runaway line, drop it
+            log->used = 0;
+    }
+}
+
+static void report(long long* latencies, size_t count, size_t missed) {
+    if (count == 0) {
+        printf("no frames measured, %zu missed\n", missed);
+        return;
+    }
+    qsort(latencies, count, sizeof(long long), compare_long_long);
+    double total = 0;
+    for (size_t i = 0; i < count; i++)
+        total += latencies[i];
+#define MS(ns) ((ns) / 1e6)
+    printf("%zu edits, %zu missed (no frame within %d ms)\n", count, missed, BENCH_FRAME_TIMEOUT_MS);
+    printf("min %.2f ms  p50 %.2f ms  p90 %.2f ms  p99 %.2f ms  max %.2f ms  mean %.2f ms\n\n", MS(latencies[0]), MS(latencies[count / 2]),
+           MS(latencies[count * 90 / 100]), MS(latencies[count * 99 / 100 < count ? count * 99 / 100 : count - 1]), MS(latencies[count - 1]), MS(total / count));
+
+    // log2 buckets, from 1 ms
+    double upper_ms = 1;
+    size_t i = 0;
+    while (i < count) {
+        size_t in_bucket = 0;
+        while (i < count && MS(latencies[i]) < upper_ms) {
+            in_bucket++;
+            i++;
+        }
+        if (in_bucket > 0 || upper_ms > 1) {
+            printf("  < %6.0f ms %6zu ", upper_ms, in_bucket);
+            for (size_t bar = 0; bar < in_bucket * 60 / count; bar++)
+                putchar('#');
+            putchar('\n');
+        }
+        upper_ms *= 2;
+    }
+#undef MS
+}
+
+int main(int argc, char** argv) {
+    size_t iterations = BENCH_DEFAULT_ITERATIONS;
+    const char* executable = BENCH_DEFAULT_EXECUTABLE;
+    const char* video_driver = BENCH_DEFAULT_VIDEO_DRIVER;
+    const char* font_family = BENCH_DEFAULT_FONT_FAMILY;
+    int option;
+    while ((option = getopt(argc, argv, "n:d:f:x:")) != -1) {
+        switch (option) {
+        case 'n': iterations = strtoull(optarg, NULL, 10); break;
+        case 'd': video_driver = optarg; break;
+        case 'f': font_family = optarg; break;
+        case 'x': executable = optarg; break;
+        default:
+            fprintf(stderr, "usage: %s [-n iterations] [-d offscreen|dummy] [-f font family] [-x path/to/froomf]\n", argv[0]);
+            return 2;
+        }
+    }
+    char executable_path[4096];
+    if (!realpath(executable, executable_path)) {
+        perror(executable);
+        return 1;
+    }
+
+    char home[] = "/tmp/latency_bench_XXXXXX";
+    if (!mkdtemp(home)) {
+        perror("mkdtemp");
+        return 1;
+    }
+    char target_path[256], conf_path[256], content[1024];
+    snprintf(target_path, sizeof(target_path), "%s/todo.org", home);
+    snprintf(conf_path, sizeof(conf_path), "%s/.currTasks.conf", home);
+    write_file(target_path, "* TODO latency warm up\n", "wb");
+    // every entry stays listed, and the window is tall enough to draw a few of them
+    snprintf(content, sizeof(content),
+             "file = \"%s\"\nkeyword = \"TODO\"\nfirst_entry_only = \"false\"\ninitial_window_width = \"800\"\ninitial_window_height = \"400\"\nfont_family = \"%s\"\n",
+             target_path, font_family);
+    write_file(conf_path, content, "wb");
+
+    int present_pipe[2];
+    if (pipe(present_pipe) != 0) {
+        perror("pipe");
+        return 1;
+    }
+    pid_t child = fork();
+    if (child < 0) {
+        perror("fork");
+        return 1;
+    }
+    if (child == 0) {
+        char present_log[64];
+        snprintf(present_log, sizeof(present_log), "/dev/fd/%d", present_pipe[1]);
+        close(present_pipe[0]);
+        setenv("HOME", home, 1);
+        setenv("SDL_VIDEODRIVER", video_driver, 1);
+        setenv("FROOMF_PRESENT_LOG", present_log, 1);
+        int null_fd = open("/dev/null", O_WRONLY);
+        dup2(null_fd, STDOUT_FILENO); // froomf's own logging isn't part of the measurement
+        execl(executable_path, executable_path, (char*)NULL);
+        perror(executable_path);
+        _exit(127);
+    }
+    close(present_pipe[1]);
+    PresentLog log = {present_pipe[0], {0}, 0};
+
+    printf("froomf %s, SDL_VIDEODRIVER=%s, %zu edits\n", executable_path, video_driver, iterations);
+    int status = 0;
+    if (wait_for_frame(&log, 1, BENCH_STARTUP_TIMEOUT_MS) < 0) {
+        fprintf(stderr, "froomf didn't present its first scan within %d ms\n", BENCH_STARTUP_TIMEOUT_MS);
+        status = 1;
+    }
+
+    long long* latencies = malloc((iterations ? iterations : 1) * sizeof(long long));
+    size_t measured = 0, missed = 0;
+    for (size_t i = 0; i < iterations && status == 0; i++) {
+        usleep((BENCH_MIN_PAUSE_MS + rand() % (BENCH_MAX_PAUSE_MS - BENCH_MIN_PAUSE_MS + 1)) * 1000);
+
+        snprintf(content, sizeof(content), "* TODO latency %zu\n", i);
+        long long edited = now_ns();
+        write_file(target_path, content, "ab");
+        long long presented = wait_for_frame(&log, i + 2, BENCH_FRAME_TIMEOUT_MS);
+        if (presented < 0) {
+            if (waitpid(child, NULL, WNOHANG) == child) {
+                fprintf(stderr, "froomf exited\n");
+                child = -1;
+                status = 1;
+            }
+            missed++;
+            continue;
+        }
+        latencies[measured++] = presented - edited;
+    }
+    report(latencies, measured, missed);
+    free(latencies);
+
+    if (child > 0) {
+        kill(child, SIGTERM); // SDL turns it into SDL_QUIT
+        waitpid(child, NULL, 0);
+    }
+    close(log.fd);
+    nftw(home, remove_entry, 16, FTW_DEPTH | FTW_PHYS);
+    return status;
+}
@@ -0,0 +1,338 @@
+// Scan, config and trim benchmark: generates synthetic org and markdown
+// corpora in a temporary directory and reports throughput and per-run latency
+// of the code behind a rescan and a config reload. It runs the same sc.h
+// functions main.c does, just without SDL around them:
+//
+//   keyword_lines_into_array  scScanFile() into fresh SC_FileMatches, then
+//                             scIndexMatches() as a snapshot merge does
+//   extract_config_values     cfLoadFile() and scConfigValues() for every
+//                             key in scConfigKeys
+//   trim_keyword_prefix       ksTrimKeywordPrefix() on every matching line
+//
+//     make bench                     (or: build/scan_bench [max_corpus_size, e.g. 1G])
+
+#define _GNU_SOURCE
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "../src/ac.h"
+#include "../src/ar.h"
+#include "../src/cf.h"
+#include "../src/ks.h"
+#include "../src/sc.h"
+
+#define BENCH_DEFAULT_MAX_SIZE (64ull << 20)
+#define BENCH_MAX_RUNS 200
+#define BENCH_MIN_RUNS 5
+#define BENCH_TIME_BUDGET_MS 2000.0 // per case, after BENCH_MIN_RUNS
+#define BENCH_SWEEP_SIZE (16ull << 20)
+#define BENCH_MAX_CONFIG_VALUES 4096
+#define BENCH_CONFIG_VALUE_CAPACITY 512 // MAX_STRING_LENGTH_CAPACITY in main.c
+
+typedef enum { CORPUS_ORG, CORPUS_MARKDOWN } CorpusFormat;
+
+typedef struct {
+    CorpusFormat format;
+    unsigned long long size;
+    double keyword_density; // fraction of lines holding a keyword
+    size_t line_length;     // average, lines vary from half to one and a half of it
+} CorpusSpec;
+
+static char* keywords[] = {"TODO", "DOING", "WAITING", "DONE"};
+#define KEYWORD_COUNT (sizeof(keywords) / sizeof(keywords[0]))
+
+static double now_ms(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000.0 + ts.tv_nsec / 1e6;
+}
+
+static int compare_double(const void* a, const void* b) {
+    double x = *(const double*)a, y = *(const double*)b;
+    return (x > y) - (x < y);
+}
+
+static unsigned long long parse_size(const char* text) {
+    char* end;
+    unsigned long long size = strtoull(text, &end, 10);
+    switch (*end) {
+    case 'k': case 'K': return size << 10;
+    case 'm': case 'M': return size << 20;
+    case 'g': case 'G': return size << 30;
+    default: return size;
+    }
+}
+
+static void format_size(unsigned long long size, char* out, size_t out_size) {
+    if (size >= (1ull << 30))
+        snprintf(out, out_size, "%lluG", size >> 30);
+    else if (size >= (1ull << 20))
+        snprintf(out, out_size, "%lluM", size >> 20);
+    else
+        snprintf(out, out_size, "%lluK", size >> 10);
+}
+
+// xorshift, so every run of the benchmark sees the same corpus
+static unsigned long long rng_state = 88172645463325252ull;
+static unsigned long long rng_next(void) {
+    rng_state ^= rng_state << 13;
+    rng_state ^= rng_state >> 7;
+    rng_state ^= rng_state << 17;
+    return rng_state;
+}
+
+// Write a corpus file of roughly spec->size bytes: headings and list items,
+// spec->keyword_density of them with a keyword, the rest plain text that
+// still has keyword first bytes in it so the prefilter can't skip it all.
+static void make_corpus(const char* path, const CorpusSpec* spec) {
+    FILE* file = fopen(path, "wb");
+    if (!file) {
+        perror(path);
+        exit(1);
+    }
+    static const char filler[] = "Deploy the wiring diagram, then write down what was done and why it took a while. ";
+    char line[4096];
+    unsigned long long written = 0;
+    unsigned long long density_threshold = (unsigned long long)(spec->keyword_density * 1e6);
+    while (written < spec->size) {
+        size_t length = spec->line_length / 2 + rng_next() % (spec->line_length + 1);
+        if (length >= sizeof(line) - 64)
+            length = sizeof(line) - 64;
+        size_t used;
+        if (rng_next() % 1000000 < density_threshold) {
+            const char* keyword = keywords[rng_next() % KEYWORD_COUNT];
+            if (spec->format == CORPUS_ORG)
+                used = (size_t)snprintf(line, sizeof(line), "%.*s %s ", (int)(1 + rng_next() % 3), "***", keyword);
+            else
+                used = (size_t)snprintf(line, sizeof(line), "- %s ", keyword);
+        } else {
+            used = (size_t)snprintf(line, sizeof(line), spec->format == CORPUS_ORG ? "  " : "");
+        }
+        while (used < length) {
+            size_t offset = rng_next() % 16;
+            size_t chunk = sizeof(filler) - 1 - offset;
+            chunk = length - used < chunk ? length - used : chunk;
+            memcpy(line + used, filler + offset, chunk);
+            used += chunk;
+        }
+        line[used++] = '\n';
+        fwrite(line, 1, used, file);
+        written += used;
+    }
+    fclose(file);
+}
+
+static void make_config(const char* path, size_t target_count, size_t comment_count) {
+    FILE* file = fopen(path, "wb");
+    if (!file) {
+        perror(path);
+        exit(1);
+    }
+    fprintf(file, "# generated by scan_bench\n");
+    for (size_t i = 0; i < target_count; i++)
+        fprintf(file, "file = \"/home/user/notes/project-%zu/todo.org\"\n", i);
+    for (size_t i = 0; i < KEYWORD_COUNT; i++)
+        fprintf(file, "keyword = \"%s\"\n", keywords[i]);
+    for (size_t i = 0; i < comment_count; i++)
+        fprintf(file, "; %zu: an old target, commented out: file = \"/tmp/old-%zu.org\"\n", i, i);
+    fprintf(file, "initial_window_width = \"2000\"\ninitial_window_height = \"100\"\ninitial_window_x = \"10\"\ninitial_window_y = \"10\"\n");
+    fprintf(file, "first_entry_only = \"false\"\ntrim_out_keywords = \"true\" # trailing comment\nmmap_targets = \"false\"\n");
+    fprintf(file, "texture_cache_budget_mb = \"16\"\nrenderer = \"auto\"\nfont_family = \"Source Code Pro\"\n");
+    fclose(file);
+}
+
+typedef struct {
+    double times[BENCH_MAX_RUNS];
+    size_t runs;
+} Timings;
+
+static void timings_add(Timings* timings, double elapsed) {
+    if (timings->runs < BENCH_MAX_RUNS)
+        timings->times[timings->runs++] = elapsed;
+}
+
+static int timings_done(const Timings* timings, double started) {
+    return timings->runs >= BENCH_MAX_RUNS || (timings->runs >= BENCH_MIN_RUNS && now_ms() - started > BENCH_TIME_BUDGET_MS);
+}
+
+static void report(const char* name, const char* corpus, Timings* timings, unsigned long long bytes, size_t lines, size_t matches) {
+    qsort(timings->times, timings->runs, sizeof(double), compare_double);
+    double p50 = timings->times[timings->runs / 2];
+    double p99 = timings->times[(timings->runs * 99) / 100 < timings->runs ? (timings->runs * 99) / 100 : timings->runs - 1];
+    printf("%-30s %-22s %9.1f MB/s %12.0f lines/s   p50 %9.3f ms   p99 %9.3f ms   %8zu matches %4zu runs\n", name, corpus, bytes / (p50 / 1000.0) / (1 << 20),
+           lines / (p50 / 1000.0), p50, p99, matches, timings->runs);
+}
+
+static size_t count_lines(const char* data, size_t size) {
+    size_t lines = 0;
+    for (const char* line = data; line < data + size; lines++) {
+        const char* newline = memchr(line, '\n', data + size - line);
+        line = newline ? newline + 1 : data + size;
+    }
+    return lines;
+}
+
+// Load and scan one file like a worker does, into matches the caller releases.
+static SC_FileMatches* scan_file(const char* path, bool use_mmap, const SC_KeywordMatcher* matcher, const SC_Cancellation* cancellation) {
+    SC_FileMatches* file_matches = scFileMatchesCreate();
+    if (scScanFile(path, 0, matcher, use_mmap, cancellation, file_matches) != SC_SCAN_DONE) {
+        perror(path);
+        exit(1);
+    }
+    return file_matches;
+}
+
+static void bench_scan(const char* path, const char* corpus, bool use_mmap, const SC_KeywordMatcher* matcher, size_t lines) {
+    atomic_int generation = 0;
+    SC_Cancellation cancellation = {&generation, 0}; // checked on every candidate line, like in main.c
+    AR_Arena index_arena;
+    arInit(&index_arena);
+    Timings timings = {0};
+    unsigned long long bytes = 0;
+    size_t matches = 0;
+    double started = now_ms();
+    while (!timings_done(&timings, started)) {
+        double start = now_ms();
+        SC_FileMatches* file_matches = scan_file(path, use_mmap, matcher, &cancellation);
+        scIndexMatches(&index_arena, &file_matches, 1, &matches);
+        bytes = file_matches->bytes_read;
+        scFileMatchesRelease(file_matches);
+        timings_add(&timings, now_ms() - start);
+        arReset(&index_arena);
+    }
+    arDestroy(&index_arena);
+    report(use_mmap ? "keyword_lines_into_array/mmap" : "keyword_lines_into_array", corpus, &timings, bytes, lines, matches);
+}
+
+// The matching lines of a corpus, trimmed one by one like entry_display_text() does.
+static void bench_trim(const char* path, const char* corpus, const SC_KeywordMatcher* matcher) {
+    SC_FileMatches* file_matches = scan_file(path, false, matcher, NULL);
+    const SC_MatchStore* store = &file_matches->matches;
+    unsigned long long bytes = 0;
+    for (size_t i = 0; i < store->span_count; i++)
+        bytes += store->spans[i].length;
+
+    char line[8192];
+    Timings timings = {0};
+    double started = now_ms();
+    while (store->span_count > 0 && !timings_done(&timings, started)) {
+        double start = now_ms();
+        for (size_t i = 0; i < store->span_count; i++) {
+            const SC_MatchSpan* span = &store->spans[i];
+            size_t length = span->length < sizeof(line) - 1 ? span->length : sizeof(line) - 1;
+            memcpy(line, span->text, length);
+            line[length] = '\0';
+            ksTrimKeywordPrefix(line, keywords[span->keyword_id]);
+        }
+        timings_add(&timings, now_ms() - start);
+    }
+    if (store->span_count > 0)
+        report("trim_keyword_prefix", corpus, &timings, bytes, store->span_count, store->span_count);
+    scFileMatchesRelease(file_matches);
+}
+
+static void bench_config(const char* path, const char* name) {
+    static char value_storage[BENCH_MAX_CONFIG_VALUES][BENCH_CONFIG_VALUE_CAPACITY];
+    static char* values[BENCH_MAX_CONFIG_VALUES];
+    for (size_t i = 0; i < BENCH_MAX_CONFIG_VALUES; i++)
+        values[i] = value_storage[i];
+    CF_Config config;
+    cfInit(&config);
+    Timings timings = {0};
+    size_t value_count = 0;
+    double started = now_ms();
+    while (!timings_done(&timings, started)) {
+        double start = now_ms();
+        cfReset(&config);
+        cfLoadFile(&config, path);
+        value_count = 0;
+        for (size_t i = 0; i < SC_CONFIG_KEY_COUNT; i++)
+            value_count += scConfigValues(&config, scConfigKeys[i], values, BENCH_MAX_CONFIG_VALUES, BENCH_CONFIG_VALUE_CAPACITY);
+        timings_add(&timings, now_ms() - start);
+    }
+    FILE* file = fopen(path, "rb");
+    fseek(file, 0, SEEK_END);
+    long size = ftell(file);
+    fclose(file);
+    report("extract_config_values", name, &timings, (unsigned long long)size, config.line_count, value_count);
+    cfDestroy(&config);
+}
+
+static void run_corpus(const char* dir, const CorpusSpec* spec, const SC_KeywordMatcher* matcher) {
+    char path[512], size_text[16], corpus[64];
+    format_size(spec->size, size_text, sizeof(size_text));
+    snprintf(corpus, sizeof(corpus), "%s %s %.1f%% %zuc", spec->format == CORPUS_ORG ? "org" : "md", size_text, spec->keyword_density * 100, spec->line_length);
+    snprintf(path, sizeof(path), "%s/corpus.%s", dir, spec->format == CORPUS_ORG ? "org" : "md");
+    make_corpus(path, spec);
+    KS_FileData file_data;
+    if (!ksLoadFile(path, false, &file_data)) {
+        perror(path);
+        exit(1);
+    }
+    size_t lines = count_lines(file_data.data, file_data.size);
+    ksReleaseFile(&file_data);
+
+    bench_scan(path, corpus, false, matcher, lines);
+#ifndef _WIN32
+    bench_scan(path, corpus, true, matcher, lines);
+#endif
+    bench_trim(path, corpus, matcher);
+    remove(path);
+}
+
+int main(int argc, char** argv) {
+    unsigned long long max_size = argc > 1 ? parse_size(argv[1]) : BENCH_DEFAULT_MAX_SIZE;
+
+    char dir[] = "/tmp/scan_bench_XXXXXX";
+    if (!mkdtemp(dir)) {
+        perror("mkdtemp");
+        return 1;
+    }
+
+    SC_KeywordMatcher matcher;
+    scKeywordMatcherCompile(&matcher, keywords, KEYWORD_COUNT);
+    printf("scan kernel: %s, corpora up to %llu MB under %s\n\n", ksKernelName(&matcher.prefilter), max_size >> 20, dir);
+
+    // 1K, 16K, 256K, 4M, 64M and 1G, at the default density and line length
+    for (unsigned long long size = 1ull << 10; size <= max_size; size <<= 4) {
+        CorpusSpec spec = {CORPUS_ORG, size, 0.01, 60};
+        run_corpus(dir, &spec, &matcher);
+    }
+    printf("\n");
+
+    // keyword density, line length and format at one size
+    unsigned long long sweep_size = max_size < BENCH_SWEEP_SIZE ? max_size : BENCH_SWEEP_SIZE;
+    double densities[] = {0.001, 0.1, 0.5};
+    for (size_t i = 0; i < sizeof(densities) / sizeof(densities[0]); i++) {
+        CorpusSpec spec = {CORPUS_ORG, sweep_size, densities[i], 60};
+        run_corpus(dir, &spec, &matcher);
+    }
+    size_t line_lengths[] = {16, 400};
+    for (size_t i = 0; i < sizeof(line_lengths) / sizeof(line_lengths[0]); i++) {
+        CorpusSpec spec = {CORPUS_ORG, sweep_size, 0.01, line_lengths[i]};
+        run_corpus(dir, &spec, &matcher);
+    }
+    CorpusSpec markdown = {CORPUS_MARKDOWN, sweep_size, 0.01, 60};
+    run_corpus(dir, &markdown, &matcher);
+    printf("\n");
+
+    // config files, from a typical one to one with a lot of targets and commented out lines
+    size_t target_counts[] = {2, 90, 2000};
+    for (size_t i = 0; i < sizeof(target_counts) / sizeof(target_counts[0]); i++) {
+        char path[512], name[64];
+        snprintf(path, sizeof(path), "%s/bench.conf", dir);
+        snprintf(name, sizeof(name), "config %zu files", target_counts[i]);
+        make_config(path, target_counts[i], target_counts[i] * 2);
+        bench_config(path, name);
+        remove(path);
+    }
+
+    scKeywordMatcherDestroy(&matcher);
+    if (rmdir(dir) != 0)
+        fprintf(stderr, "rmdir %s: %s\n", dir, strerror(errno));
+    return 0;
+}
@@ -0,0 +1,144 @@
+// clang-format Language: C
+#ifndef AC_H_
+#define AC_H_
+
+#define AC_ALPHABET_SIZE 256
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+typedef struct AC_Automaton AC_Automaton;
+void acInit(AC_Automaton* ac);
+void acAddKeyword(AC_Automaton* ac, const char* keyword, int id);
+void acCompile(AC_Automaton* ac);
+int acFind(const AC_Automaton* ac, const char* text, size_t length, size_t* match_end);
+void acDestroy(AC_Automaton* ac);
+
+// Implementation:
+
+// Aho-Corasick keyword matcher. Keywords are added to a trie, and acCompile()
+// folds the failure links into a dense transition table, so scanning costs one
+// table lookup per input byte no matter how many keywords there are.
+typedef struct AC_Automaton {
+    int32_t* next;   // [state * AC_ALPHABET_SIZE + byte] -> state, -1 for "no trie edge" until compiled
+    int32_t* output; // keyword id recognized when entering a state, -1 for none
+    size_t size;     // number of states, state 0 is the root
+    size_t capacity;
+    int compiled;
+} AC_Automaton;
+
+static int32_t acNewState(AC_Automaton* ac) {
+    if (ac->capacity < ac->size + 1) {
+        size_t newCap = ac->capacity ? ac->capacity * 2 : 64;
+        int32_t* next = realloc(ac->next, newCap * AC_ALPHABET_SIZE * sizeof(int32_t));
+        if (!next)
+            abort();
+        ac->next = next;
+        int32_t* output = realloc(ac->output, newCap * sizeof(int32_t));
+        if (!output)
+            abort();
+        ac->output = output;
+        ac->capacity = newCap;
+    }
+    int32_t state = (int32_t)ac->size++;
+    memset(&ac->next[state * AC_ALPHABET_SIZE], 0xff, AC_ALPHABET_SIZE * sizeof(int32_t)); // all -1
+    ac->output[state] = -1;
+    return state;
+}
+
+void acInit(AC_Automaton* ac) {
+    memset(ac, 0, sizeof(*ac));
+    acNewState(ac); // root
+}
+
+// Add a keyword before acCompile(). Empty keywords are ignored, and when the
+// same keyword is added twice the first id wins.
+void acAddKeyword(AC_Automaton* ac, const char* keyword, int id) {
+    if (ac->compiled || !keyword || *keyword == '\0')
+        return;
+
+    int32_t state = 0;
+    for (const unsigned char* ch = (const unsigned char*)keyword; *ch; ch++) {
+        int32_t child = ac->next[state * AC_ALPHABET_SIZE + *ch];
+        if (child < 0) {
+            child = acNewState(ac);
+            ac->next[state * AC_ALPHABET_SIZE + *ch] = child;
+        }
+        state = child;
+    }
+    if (ac->output[state] < 0)
+        ac->output[state] = id;
+}
+
+void acCompile(AC_Automaton* ac) {
+    if (ac->compiled)
+        return;
+
+    int32_t* fail = calloc(ac->size, sizeof(int32_t));
+    int32_t* queue = malloc(ac->size * sizeof(int32_t));
+    if (!fail || !queue)
+        abort();
+    size_t head = 0, tail = 0;
+
+    // depth 1 states fail to the root, missing root edges loop on the root
+    for (int c = 0; c < AC_ALPHABET_SIZE; c++) {
+        int32_t child = ac->next[c];
+        if (child < 0) {
+            ac->next[c] = 0;
+        } else {
+            fail[child] = 0;
+            queue[tail++] = child;
+        }
+    }
+
+    // breadth first, so a state's failure target is always complete before it is used
+    while (head < tail) {
+        int32_t state = queue[head++];
+        for (int c = 0; c < AC_ALPHABET_SIZE; c++) {
+            int32_t* edge = &ac->next[state * AC_ALPHABET_SIZE + c];
+            int32_t fallback = ac->next[fail[state] * AC_ALPHABET_SIZE + c];
+            if (*edge < 0) {
+                *edge = fallback;
+            } else {
+                fail[*edge] = fallback;
+                if (ac->output[*edge] < 0) // a keyword that is a suffix of this path also ends here
+                    ac->output[*edge] = ac->output[fallback];
+                queue[tail++] = *edge;
+            }
+        }
+    }
+
+    free(queue);
+    free(fail);
+    ac->compiled = 1;
+}
+
+// Scan text in a single pass. Returns the id of the keyword occurrence that
+// ends first, and stores the offset just past it in *match_end. Returns -1
+// when no keyword occurs in text.
+int acFind(const AC_Automaton* ac, const char* text, size_t length, size_t* match_end) {
+    if (!ac->compiled)
+        return -1;
+
+    const int32_t* next = ac->next;
+    const int32_t* output = ac->output;
+    int32_t state = 0;
+    for (size_t i = 0; i < length; i++) {
+        state = next[state * AC_ALPHABET_SIZE + (unsigned char)text[i]];
+        if (output[state] >= 0) {
+            if (match_end)
+                *match_end = i + 1;
+            return output[state];
+        }
+    }
+    return -1;
+}
+
+void acDestroy(AC_Automaton* ac) {
+    free(ac->next);
+    free(ac->output);
+    memset(ac, 0, sizeof(*ac));
+}
+
+#endif // AC_H_
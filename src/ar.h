@@ -0,0 +1,145 @@
+// clang-format Language: C
+#ifndef AR_H_
+#define AR_H_
+
+#define AR_FIRST_CHUNK_SIZE 4096
+#define AR_MAX_CHUNK_SIZE (1024 * 1024)
+
+#include <stdalign.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+typedef struct AR_Arena AR_Arena;
+void arInit(AR_Arena* arena);
+void* arAlloc(AR_Arena* arena, size_t size, size_t alignment);
+void* arGrowArray(AR_Arena* arena, void* array, size_t old_size, size_t new_size, size_t alignment);
+char* arStrndup(AR_Arena* arena, const char* str, size_t length);
+void arReset(AR_Arena* arena);
+void arDestroy(AR_Arena* arena);
+size_t arBytesUsed(const AR_Arena* arena);
+
+// Implementation:
+
+typedef struct AR_Chunk {
+    struct AR_Chunk* next;
+    size_t used;
+    size_t capacity;
+    alignas(max_align_t) unsigned char data[];
+} AR_Chunk;
+
+// Bump allocator. Allocations are carved out of chunks one after another and
+// are only ever freed all at once by arReset()/arDestroy(), so strings pushed
+// back to back end up packed contiguously. Chunks double in size as the arena
+// grows, and arReset() keeps only the first one around.
+typedef struct AR_Arena {
+    AR_Chunk* first;
+    AR_Chunk* current;
+    size_t next_chunk_size;
+    size_t bytes_used;
+} AR_Arena;
+
+void arInit(AR_Arena* arena) {
+    memset(arena, 0, sizeof(*arena));
+    arena->next_chunk_size = AR_FIRST_CHUNK_SIZE;
+}
+
+static AR_Chunk* arNewChunk(AR_Arena* arena, size_t min_capacity) {
+    size_t capacity = arena->next_chunk_size;
+    while (capacity < min_capacity)
+        capacity *= 2;
+    if (arena->next_chunk_size < AR_MAX_CHUNK_SIZE)
+        arena->next_chunk_size *= 2;
+
+    AR_Chunk* chunk = malloc(sizeof(AR_Chunk) + capacity);
+    if (!chunk)
+        abort();
+    chunk->next = NULL;
+    chunk->used = 0;
+    chunk->capacity = capacity;
+    return chunk;
+}
+
+// alignment must be a power of two.
+void* arAlloc(AR_Arena* arena, size_t size, size_t alignment) {
+    AR_Chunk* chunk = arena->current;
+    if (chunk) {
+        size_t start = (chunk->used + alignment - 1) & ~(alignment - 1);
+        if (start + size <= chunk->capacity) {
+            chunk->used = start + size;
+            arena->bytes_used += size;
+            return chunk->data + start;
+        }
+    }
+
+    AR_Chunk* fresh = arNewChunk(arena, size);
+    if (chunk)
+        chunk->next = fresh;
+    else
+        arena->first = fresh;
+    arena->current = fresh;
+
+    fresh->used = size; // chunk data is max_align_t aligned
+    arena->bytes_used += size;
+    return fresh->data;
+}
+
+// Grow the most recent allocation in place when it sits at the end of the
+// current chunk, otherwise move it to a fresh block (the old one is
+// reclaimed at the next reset).
+void* arGrowArray(AR_Arena* arena, void* array, size_t old_size, size_t new_size, size_t alignment) {
+    AR_Chunk* chunk = arena->current;
+    if (array && chunk && (unsigned char*)array + old_size == chunk->data + chunk->used &&
+        (size_t)((unsigned char*)array - chunk->data) + new_size <= chunk->capacity) {
+        chunk->used += new_size - old_size;
+        arena->bytes_used += new_size - old_size;
+        return array;
+    }
+
+    void* grown = arAlloc(arena, new_size, alignment);
+    if (array && old_size)
+        memcpy(grown, array, old_size);
+    return grown;
+}
+
+char* arStrndup(AR_Arena* arena, const char* str, size_t length) {
+    char* copy = arAlloc(arena, length + 1, 1);
+    memcpy(copy, str, length);
+    copy[length] = '\0';
+    return copy;
+}
+
+// Forget every allocation. The first chunk is kept for reuse, the rest are
+// freed so that memory follows what is actually stored.
+void arReset(AR_Arena* arena) {
+    if (!arena->first)
+        return;
+    AR_Chunk* chunk = arena->first->next;
+    while (chunk) {
+        AR_Chunk* next = chunk->next;
+        free(chunk);
+        chunk = next;
+    }
+    arena->first->next = NULL;
+    arena->first->used = 0;
+    arena->current = arena->first;
+    arena->next_chunk_size = arena->first->capacity * 2;
+    arena->bytes_used = 0;
+}
+
+void arDestroy(AR_Arena* arena) {
+    AR_Chunk* chunk = arena->first;
+    while (chunk) {
+        AR_Chunk* next = chunk->next;
+        free(chunk);
+        chunk = next;
+    }
+    arInit(arena);
+}
+
+size_t arBytesUsed(const AR_Arena* arena) {
+    return arena->bytes_used;
+}
+
+#endif // AR_H_
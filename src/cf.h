@@ -0,0 +1,324 @@
+// clang-format Language: C
+#ifndef CF_H_
+#define CF_H_
+
+#define CF_MAX_ERRORS 16
+#define CF_ERROR_MESSAGE_SIZE 96
+
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "ar.h"
+
+typedef struct CF_Config CF_Config;
+void cfInit(CF_Config* config);
+size_t cfParse(CF_Config* config, const char* text, size_t length);
+int cfLoadFile(CF_Config* config, const char* path);
+size_t cfCount(const CF_Config* config, const char* key);
+const char* cfGet(const CF_Config* config, const char* key, size_t index);
+int cfValuesEqual(const CF_Config* a, const CF_Config* b, const char* key);
+void cfReset(CF_Config* config);
+void cfDestroy(CF_Config* config);
+
+// Implementation:
+
+typedef struct {
+    const char* key;
+    const char** values; // in file order, duplicates dropped
+    size_t count;
+    size_t capacity;
+    size_t line; // where the key first appears
+} CF_Entry;
+
+typedef struct {
+    size_t line;
+    char message[CF_ERROR_MESSAGE_SIZE];
+} CF_Error;
+
+typedef struct {
+    size_t entry; // (size_t)-1 for empty
+    const char* value;
+} CF_ValueSlot;
+
+// `key = "value"` configuration, one setting per line. Keys may repeat to
+// build a list. Blank lines and lines starting with '#' or ';' are skipped,
+// and a comment may also follow the value. Values are taken verbatim between
+// the quotes (no escapes, so Windows paths need no doubling).
+//
+// The text is tokenized in a single pass into a hash table of key -> values.
+// Lines that don't parse are skipped and reported in `errors`.
+typedef struct CF_Config {
+    AR_Arena arena; // keys, values and value arrays
+    CF_Entry* entries;
+    size_t entry_count;
+    size_t entry_capacity;
+    size_t* slots; // open addressing index into entries, (size_t)-1 for empty
+    size_t slot_count;
+    CF_ValueSlot* value_slots; // every (key, value) pair, to drop duplicates
+    size_t value_slot_count;
+    size_t value_count;
+    CF_Error errors[CF_MAX_ERRORS];
+    size_t error_count; // may be more than CF_MAX_ERRORS, only the first ones are kept
+    size_t line_count;
+} CF_Config;
+
+void cfInit(CF_Config* config) {
+    memset(config, 0, sizeof(*config));
+    arInit(&config->arena);
+}
+
+void cfReset(CF_Config* config) {
+    arReset(&config->arena);
+    config->entry_count = 0;
+    if (config->slots)
+        memset(config->slots, 0xff, config->slot_count * sizeof(size_t));
+    if (config->value_slots)
+        memset(config->value_slots, 0xff, config->value_slot_count * sizeof(CF_ValueSlot));
+    config->value_count = 0;
+    config->error_count = 0;
+    config->line_count = 0;
+}
+
+void cfDestroy(CF_Config* config) {
+    arDestroy(&config->arena);
+    free(config->entries);
+    free(config->slots);
+    free(config->value_slots);
+    memset(config, 0, sizeof(*config));
+}
+
+static size_t cfHash(const char* key, size_t length) {
+    size_t hash = 2166136261u;
+    for (size_t i = 0; i < length; i++)
+        hash = (hash ^ (unsigned char)key[i]) * 16777619u;
+    return hash;
+}
+
+static CF_Entry* cfFind(const CF_Config* config, const char* key, size_t length) {
+    if (config->slot_count == 0)
+        return NULL;
+    size_t slot = cfHash(key, length) & (config->slot_count - 1);
+    while (config->slots[slot] != (size_t)-1) {
+        CF_Entry* entry = &config->entries[config->slots[slot]];
+        if (strncmp(entry->key, key, length) == 0 && entry->key[length] == '\0')
+            return entry;
+        slot = (slot + 1) & (config->slot_count - 1);
+    }
+    return NULL;
+}
+
+static CF_Entry* cfAddEntry(CF_Config* config, const char* key, size_t length, size_t line) {
+    if (config->entry_capacity < config->entry_count + 1) {
+        size_t newCap = config->entry_capacity ? config->entry_capacity * 2 : 16;
+        CF_Entry* tmp = realloc(config->entries, newCap * sizeof(CF_Entry));
+        if (!tmp)
+            abort();
+        config->entries = tmp;
+        config->entry_capacity = newCap;
+    }
+    if (config->slot_count < config->entry_capacity * 2) {
+        free(config->slots);
+        config->slot_count = config->entry_capacity * 2;
+        config->slots = malloc(config->slot_count * sizeof(size_t));
+        if (!config->slots)
+            abort();
+        memset(config->slots, 0xff, config->slot_count * sizeof(size_t));
+        for (size_t i = 0; i < config->entry_count; i++) {
+            size_t slot = cfHash(config->entries[i].key, strlen(config->entries[i].key)) & (config->slot_count - 1);
+            while (config->slots[slot] != (size_t)-1)
+                slot = (slot + 1) & (config->slot_count - 1);
+            config->slots[slot] = i;
+        }
+    }
+
+    CF_Entry* entry = &config->entries[config->entry_count];
+    entry->key = arStrndup(&config->arena, key, length);
+    entry->values = NULL;
+    entry->count = entry->capacity = 0;
+    entry->line = line;
+    size_t slot = cfHash(key, length) & (config->slot_count - 1);
+    while (config->slots[slot] != (size_t)-1)
+        slot = (slot + 1) & (config->slot_count - 1);
+    config->slots[slot] = config->entry_count++;
+    return entry;
+}
+
+static size_t cfValueHash(size_t entry, const char* value, size_t length) {
+    return cfHash(value, length) ^ (entry * 0x9e3779b9u);
+}
+
+static void cfAddValue(CF_Config* config, CF_Entry* entry, const char* value, size_t length) {
+    size_t entry_index = entry - config->entries;
+    if (config->value_slot_count < (config->value_count + 1) * 2) {
+        CF_ValueSlot* old_slots = config->value_slots;
+        size_t old_count = config->value_slot_count;
+        config->value_slot_count = old_count ? old_count * 2 : 64;
+        config->value_slots = malloc(config->value_slot_count * sizeof(CF_ValueSlot));
+        if (!config->value_slots)
+            abort();
+        memset(config->value_slots, 0xff, config->value_slot_count * sizeof(CF_ValueSlot));
+        for (size_t i = 0; i < old_count; i++) {
+            if (old_slots[i].entry == (size_t)-1)
+                continue;
+            size_t slot = cfValueHash(old_slots[i].entry, old_slots[i].value, strlen(old_slots[i].value)) & (config->value_slot_count - 1);
+            while (config->value_slots[slot].entry != (size_t)-1)
+                slot = (slot + 1) & (config->value_slot_count - 1);
+            config->value_slots[slot] = old_slots[i];
+        }
+        free(old_slots);
+    }
+
+    size_t slot = cfValueHash(entry_index, value, length) & (config->value_slot_count - 1);
+    for (; config->value_slots[slot].entry != (size_t)-1; slot = (slot + 1) & (config->value_slot_count - 1)) {
+        const CF_ValueSlot* seen = &config->value_slots[slot];
+        if (seen->entry == entry_index && strncmp(seen->value, value, length) == 0 && seen->value[length] == '\0')
+            return; // duplicate
+    }
+
+    if (entry->capacity < entry->count + 1) {
+        size_t newCap = entry->capacity ? entry->capacity * 2 : 4;
+        entry->values = arGrowArray(&config->arena, entry->values, entry->capacity * sizeof(char*), newCap * sizeof(char*), sizeof(char*));
+        entry->capacity = newCap;
+    }
+    entry->values[entry->count] = arStrndup(&config->arena, value, length);
+    config->value_slots[slot].entry = entry_index;
+    config->value_slots[slot].value = entry->values[entry->count++];
+    config->value_count++;
+}
+
+static void cfAddError(CF_Config* config, size_t line, const char* message) {
+    if (config->error_count < CF_MAX_ERRORS) {
+        CF_Error* error = &config->errors[config->error_count];
+        error->line = line;
+        snprintf(error->message, sizeof(error->message), "%s", message);
+    }
+    config->error_count++;
+}
+
+static int cfIsKeyChar(char ch) {
+    return (ch >= 'a' && ch <= 'z') || (ch >= 'A' && ch <= 'Z') || (ch >= '0' && ch <= '9') || ch == '_' || ch == '-' || ch == '.';
+}
+
+static const char* cfSkipBlanks(const char* ch, const char* end) {
+    while (ch < end && (*ch == ' ' || *ch == '\t'))
+        ch++;
+    return ch;
+}
+
+// Parse text (adding to what was parsed before). Returns the number of
+// syntax errors found.
+size_t cfParse(CF_Config* config, const char* text, size_t length) {
+    size_t errors_before = config->error_count;
+    const char* end = text + length;
+    const char* line_start = text;
+    size_t line = 0;
+
+    while (line_start < end) {
+        const char* line_end = memchr(line_start, '\n', end - line_start);
+        if (!line_end)
+            line_end = end;
+        const char* next_line = line_end < end ? line_end + 1 : end;
+        if (line_end > line_start && line_end[-1] == '\r')
+            line_end--;
+        line++;
+
+        const char* ch = cfSkipBlanks(line_start, line_end);
+        if (ch == line_end || *ch == '#' || *ch == ';') {
+            line_start = next_line;
+            continue;
+        }
+
+        const char* key = ch;
+        while (ch < line_end && cfIsKeyChar(*ch))
+            ch++;
+        size_t key_length = ch - key;
+        ch = cfSkipBlanks(ch, line_end);
+
+        const char* value = NULL;
+        const char* value_end = NULL;
+        if (key_length == 0) {
+            cfAddError(config, line, "expected a key");
+        } else if (ch == line_end || *ch != '=') {
+            cfAddError(config, line, "expected '=' after the key");
+        } else if ((ch = cfSkipBlanks(ch + 1, line_end)) == line_end || *ch != '"') {
+            cfAddError(config, line, "expected a quoted value after '='");
+        } else if (!(value_end = memchr(ch + 1, '"', line_end - ch - 1))) {
+            cfAddError(config, line, "missing the closing quote");
+        } else {
+            value = ch + 1;
+            ch = cfSkipBlanks(value_end + 1, line_end);
+            if (ch != line_end && *ch != '#' && *ch != ';') {
+                cfAddError(config, line, "unexpected text after the value");
+                value = NULL;
+            }
+        }
+
+        if (value) {
+            CF_Entry* entry = cfFind(config, key, key_length);
+            if (!entry)
+                entry = cfAddEntry(config, key, key_length, line);
+            cfAddValue(config, entry, value, value_end - value);
+        }
+        line_start = next_line;
+    }
+
+    config->line_count += line;
+    return config->error_count - errors_before;
+}
+
+// Parse a whole file. Returns -1 if it can't be read.
+int cfLoadFile(CF_Config* config, const char* path) {
+    FILE* file = fopen(path, "rb");
+    if (!file)
+        return -1;
+
+    size_t capacity = 4096, size = 0;
+    char* text = malloc(capacity);
+    if (!text)
+        abort();
+    size_t got;
+    while ((got = fread(text + size, 1, capacity - size, file)) > 0) {
+        size += got;
+        if (size == capacity) {
+            capacity *= 2;
+            text = realloc(text, capacity);
+            if (!text)
+                abort();
+        }
+    }
+    fclose(file);
+
+    cfParse(config, text, size);
+    free(text);
+    return 0;
+}
+
+size_t cfCount(const CF_Config* config, const char* key) {
+    const CF_Entry* entry = cfFind(config, key, strlen(key));
+    return entry ? entry->count : 0;
+}
+
+// The index-th value of key, NULL past the end.
+const char* cfGet(const CF_Config* config, const char* key, size_t index) {
+    const CF_Entry* entry = cfFind(config, key, strlen(key));
+    return (entry && index < entry->count) ? entry->values[index] : NULL;
+}
+
+// Whether key has the same values, in the same order, in both configs.
+int cfValuesEqual(const CF_Config* a, const CF_Config* b, const char* key) {
+    size_t length = strlen(key);
+    const CF_Entry* entry_a = cfFind(a, key, length);
+    const CF_Entry* entry_b = cfFind(b, key, length);
+    size_t count = entry_a ? entry_a->count : 0;
+    if (count != (entry_b ? entry_b->count : 0))
+        return 0;
+    for (size_t i = 0; i < count; i++) {
+        if (strcmp(entry_a->values[i], entry_b->values[i]) != 0)
+            return 0;
+    }
+    return 1;
+}
+
+#endif // CF_H_
@@ -0,0 +1,489 @@
+// clang-format Language: C
+#ifndef DW_H_
+#define DW_H_
+
+#define DW_DEFAULT_MAX_DEPTH 64
+#define DW_FOLLOW_SYMLINKS 1
+
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+
+typedef enum { DW_FILE, DW_DIR } DW_EntryType;
+
+// What a DW_Callback returns. DW_SKIP on a directory leaves its contents out.
+enum { DW_CONTINUE, DW_SKIP, DW_STOP };
+
+typedef struct DW_Walker DW_Walker;
+
+typedef struct {
+    const char* path; // the pushed directory joined with the entry's name(s), only valid during the callback
+    size_t path_length;
+    const char* name; // last component of path
+    DW_EntryType type;
+    int depth;         // depth given to dwPush() for the pushed directories, +1 per level below them
+    long long mtime;   // DW_DIR only, ns on POSIX, 100ns ticks on Windows
+    DW_Walker* walker; // for calling dwPush() from the callback
+} DW_Entry;
+
+// Called for every regular file and directory. A directory is reported
+// before its contents, right after it was opened.
+typedef int (*DW_Callback)(const DW_Entry* entry, void* user);
+
+void dwInit(DW_Walker* walker, int flags, int max_depth);
+void dwPush(DW_Walker* walker, const char* dir_path, int depth);
+int dwRun(DW_Walker* walker, DW_Callback on_entry, void* user);
+void dwDestroy(DW_Walker* walker);
+
+// Implementation:
+
+typedef struct {
+    char* path;
+    int depth;
+} DW_Pending;
+
+#ifdef _WIN32
+    #include <windows.h>
+
+typedef struct {
+    HANDLE find_handle;
+    WIN32_FIND_DATAA find_data;
+    int has_find_data; // find_data holds an entry not handed out yet
+    size_t path_length;
+    int depth;
+} DW_Frame;
+
+#else
+    #include <dirent.h>
+    #include <fcntl.h>
+    #include <sys/stat.h>
+    #include <unistd.h>
+
+typedef struct {
+    DIR* dir;
+    size_t path_length;
+    int depth;
+} DW_Frame;
+
+typedef struct {
+    dev_t dev;
+    ino_t ino;
+    int used;
+} DW_DirId;
+#endif
+
+// Iterative directory walker. Open directories are kept on an explicit stack
+// (one descriptor per level, bounded by max_depth) and entries are opened
+// relative to their parent's descriptor, so no full path is ever resolved
+// again. The entry type comes from d_type, with an fstatat() only when the
+// filesystem doesn't fill it in or the entry is a symlink to follow. On
+// POSIX every directory's (st_dev, st_ino) is remembered, so symlink loops
+// and directories reachable twice are walked only once.
+//
+// Directories pushed with dwPush() are walked in order, after whatever is
+// on the stack.
+typedef struct DW_Walker {
+    int flags;
+    int max_depth;
+
+    DW_Pending* pending;
+    size_t pending_head;
+    size_t pending_count;
+    size_t pending_capacity;
+
+    DW_Frame* frames;
+    size_t frame_count;
+    size_t frame_capacity;
+
+    char* path;
+    size_t path_capacity;
+
+#ifndef _WIN32
+    DW_DirId* visited;
+    size_t visited_count;
+    size_t visited_slots;
+#endif
+
+    // what the walks cost so far
+    size_t dirs_walked;
+    size_t entries_seen;
+    size_t stat_calls;
+    size_t loops_skipped;
+} DW_Walker;
+
+void dwInit(DW_Walker* walker, int flags, int max_depth) {
+    memset(walker, 0, sizeof(*walker));
+    walker->flags = flags;
+    walker->max_depth = max_depth > 0 ? max_depth : DW_DEFAULT_MAX_DEPTH;
+}
+
+void dwPush(DW_Walker* walker, const char* dir_path, int depth) {
+    if (walker->pending_capacity < walker->pending_count + 1) {
+        size_t newCap = walker->pending_capacity ? walker->pending_capacity * 2 : 16;
+        DW_Pending* tmp = realloc(walker->pending, newCap * sizeof(DW_Pending));
+        if (!tmp)
+            abort();
+        walker->pending = tmp;
+        walker->pending_capacity = newCap;
+    }
+    char* copy = strdup(dir_path);
+    if (!copy)
+        abort();
+    size_t length = strlen(copy);
+    while (length > 1 && (copy[length - 1] == '/' || copy[length - 1] == '\\'))
+        copy[--length] = '\0';
+    walker->pending[walker->pending_count].path = copy;
+    walker->pending[walker->pending_count].depth = depth;
+    walker->pending_count++;
+}
+
+static DW_Frame* dwPushFrame(DW_Walker* walker) {
+    if (walker->frame_capacity < walker->frame_count + 1) {
+        size_t newCap = walker->frame_capacity ? walker->frame_capacity * 2 : 16;
+        DW_Frame* tmp = realloc(walker->frames, newCap * sizeof(DW_Frame));
+        if (!tmp)
+            abort();
+        walker->frames = tmp;
+        walker->frame_capacity = newCap;
+    }
+    return &walker->frames[walker->frame_count++];
+}
+
+// Write name after the first parent_length bytes of the path buffer, with a
+// separator in between. Returns the new length, *name_offset gets where the
+// name starts.
+static size_t dwJoin(DW_Walker* walker, size_t parent_length, const char* name, size_t* name_offset, char separator) {
+    size_t name_length = strlen(name);
+    int needs_separator = parent_length > 0 && walker->path[parent_length - 1] != '/' && walker->path[parent_length - 1] != '\\';
+    size_t length = parent_length + needs_separator + name_length;
+    if (walker->path_capacity < length + 1) {
+        size_t newCap = walker->path_capacity ? walker->path_capacity : 256;
+        while (newCap < length + 1)
+            newCap *= 2;
+        char* tmp = realloc(walker->path, newCap);
+        if (!tmp)
+            abort();
+        walker->path = tmp;
+        walker->path_capacity = newCap;
+    }
+    if (needs_separator)
+        walker->path[parent_length] = separator;
+    *name_offset = parent_length + needs_separator;
+    memcpy(walker->path + *name_offset, name, name_length + 1);
+    return length;
+}
+
+// The last component of a pushed path, for DW_Entry::name.
+static size_t dwBaseNameOffset(const char* path, size_t length) {
+    size_t offset = length;
+    while (offset > 0 && path[offset - 1] != '/' && path[offset - 1] != '\\')
+        offset--;
+    return offset == length ? 0 : offset;
+}
+
+static void dwClosePending(DW_Walker* walker) {
+    for (size_t i = walker->pending_head; i < walker->pending_count; i++)
+        free(walker->pending[i].path);
+    walker->pending_head = walker->pending_count = 0;
+}
+
+#ifdef _WIN32
+
+static void dwCloseFrames(DW_Walker* walker) {
+    while (walker->frame_count > 0)
+        FindClose(walker->frames[--walker->frame_count].find_handle);
+}
+
+// Windows has no inodes to compare, so reparse points (symlinks, junctions)
+// are only followed with DW_FOLLOW_SYMLINKS, and max_depth bounds any loop.
+static int dwEnterDir(DW_Walker* walker, size_t path_length, size_t name_offset, int depth, DW_Callback on_entry, void* user) {
+    WIN32_FILE_ATTRIBUTE_DATA attributes;
+    if (!GetFileAttributesExA(walker->path, GetFileExInfoStandard, &attributes) ||
+        !(attributes.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY))
+        return DW_CONTINUE;
+    walker->stat_calls++;
+
+    DW_Entry entry;
+    entry.path = walker->path;
+    entry.path_length = path_length;
+    entry.name = walker->path + name_offset;
+    entry.type = DW_DIR;
+    entry.depth = depth;
+    entry.mtime = ((long long)attributes.ftLastWriteTime.dwHighDateTime << 32) | attributes.ftLastWriteTime.dwLowDateTime;
+    entry.walker = walker;
+    int action = on_entry(&entry, user);
+    if (action != DW_CONTINUE)
+        return action;
+
+    size_t search_offset;
+    dwJoin(walker, path_length, "*", &search_offset, '\\');
+    WIN32_FIND_DATAA find_data;
+    HANDLE find_handle = FindFirstFileA(walker->path, &find_data);
+    walker->path[path_length] = '\0';
+    if (find_handle == INVALID_HANDLE_VALUE)
+        return DW_CONTINUE;
+
+    DW_Frame* frame = dwPushFrame(walker);
+    frame->find_handle = find_handle;
+    frame->find_data = find_data;
+    frame->has_find_data = 1;
+    frame->path_length = path_length;
+    frame->depth = depth;
+    walker->dirs_walked++;
+    return DW_CONTINUE;
+}
+
+// Walk everything pushed so far. Returns 1 if on_entry stopped the walk.
+int dwRun(DW_Walker* walker, DW_Callback on_entry, void* user) {
+    int action = DW_CONTINUE;
+    while (action != DW_STOP) {
+        if (walker->frame_count == 0) {
+            if (walker->pending_head == walker->pending_count) {
+                walker->pending_head = walker->pending_count = 0;
+                break;
+            }
+            DW_Pending next = walker->pending[walker->pending_head++];
+            size_t name_offset;
+            size_t length = dwJoin(walker, 0, next.path, &name_offset, '\\');
+            free(next.path);
+            action = dwEnterDir(walker, length, dwBaseNameOffset(walker->path, length), next.depth, on_entry, user);
+            continue;
+        }
+
+        DW_Frame* frame = &walker->frames[walker->frame_count - 1];
+        if (!frame->has_find_data && !FindNextFileA(frame->find_handle, &frame->find_data)) {
+            FindClose(frame->find_handle);
+            walker->frame_count--;
+            continue;
+        }
+        frame->has_find_data = 0;
+
+        const WIN32_FIND_DATAA* find_data = &frame->find_data;
+        const char* name = find_data->cFileName;
+        if (name[0] == '.' && (name[1] == '\0' || (name[1] == '.' && name[2] == '\0')))
+            continue;
+        walker->entries_seen++;
+
+        int is_dir = (find_data->dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) != 0;
+        if (is_dir && (find_data->dwFileAttributes & FILE_ATTRIBUTE_REPARSE_POINT) && !(walker->flags & DW_FOLLOW_SYMLINKS))
+            continue;
+
+        int depth = frame->depth + 1;
+        size_t name_offset;
+        size_t length = dwJoin(walker, frame->path_length, name, &name_offset, '\\');
+        if (is_dir) {
+            if (depth <= walker->max_depth)
+                action = dwEnterDir(walker, length, name_offset, depth, on_entry, user);
+        } else {
+            DW_Entry entry;
+            entry.path = walker->path;
+            entry.path_length = length;
+            entry.name = walker->path + name_offset;
+            entry.type = DW_FILE;
+            entry.depth = depth;
+            entry.mtime = 0;
+            entry.walker = walker;
+            action = on_entry(&entry, user);
+        }
+    }
+
+    if (action == DW_STOP) {
+        dwCloseFrames(walker);
+        return 1;
+    }
+    return 0;
+}
+
+#else
+
+static void dwCloseFrames(DW_Walker* walker) {
+    while (walker->frame_count > 0)
+        closedir(walker->frames[--walker->frame_count].dir);
+}
+
+static size_t dwHashDirId(dev_t dev, ino_t ino) {
+    unsigned long long key = (unsigned long long)ino * 0x9E3779B97F4A7C15ull ^ (unsigned long long)dev;
+    return (size_t)(key ^ (key >> 29));
+}
+
+// Returns 0 when the directory was already visited.
+static int dwMarkVisited(DW_Walker* walker, dev_t dev, ino_t ino) {
+    if (walker->visited_slots < (walker->visited_count + 1) * 2) {
+        size_t old_slots = walker->visited_slots;
+        DW_DirId* old = walker->visited;
+        walker->visited_slots = old_slots ? old_slots * 2 : 256;
+        walker->visited = calloc(walker->visited_slots, sizeof(DW_DirId));
+        if (!walker->visited)
+            abort();
+        for (size_t i = 0; i < old_slots; i++) {
+            if (!old[i].used)
+                continue;
+            size_t slot = dwHashDirId(old[i].dev, old[i].ino) & (walker->visited_slots - 1);
+            while (walker->visited[slot].used)
+                slot = (slot + 1) & (walker->visited_slots - 1);
+            walker->visited[slot] = old[i];
+        }
+        free(old);
+    }
+
+    size_t slot = dwHashDirId(dev, ino) & (walker->visited_slots - 1);
+    while (walker->visited[slot].used) {
+        if (walker->visited[slot].dev == dev && walker->visited[slot].ino == ino)
+            return 0;
+        slot = (slot + 1) & (walker->visited_slots - 1);
+    }
+    walker->visited[slot].dev = dev;
+    walker->visited[slot].ino = ino;
+    walker->visited[slot].used = 1;
+    walker->visited_count++;
+    return 1;
+}
+
+// Takes ownership of fd.
+static int dwEnterDir(DW_Walker* walker, int fd, size_t path_length, size_t name_offset, int depth, DW_Callback on_entry, void* user) {
+    struct stat dir_st;
+    if (fstat(fd, &dir_st) != 0 || !S_ISDIR(dir_st.st_mode)) {
+        close(fd);
+        return DW_CONTINUE;
+    }
+    if (!dwMarkVisited(walker, dir_st.st_dev, dir_st.st_ino)) {
+        close(fd);
+        walker->loops_skipped++;
+        return DW_CONTINUE;
+    }
+
+    DW_Entry entry;
+    entry.path = walker->path;
+    entry.path_length = path_length;
+    entry.name = walker->path + name_offset;
+    entry.type = DW_DIR;
+    entry.depth = depth;
+    #if defined(__linux__)
+    entry.mtime = (long long)dir_st.st_mtim.tv_sec * 1000000000LL + dir_st.st_mtim.tv_nsec;
+    #elif defined(__APPLE__)
+    entry.mtime = (long long)dir_st.st_mtimespec.tv_sec * 1000000000LL + dir_st.st_mtimespec.tv_nsec;
+    #else
+    entry.mtime = (long long)dir_st.st_mtime * 1000000000LL;
+    #endif
+    entry.walker = walker;
+    int action = on_entry(&entry, user);
+    if (action != DW_CONTINUE) {
+        close(fd);
+        return action;
+    }
+
+    DIR* dir = fdopendir(fd);
+    if (!dir) {
+        close(fd);
+        return DW_CONTINUE;
+    }
+    DW_Frame* frame = dwPushFrame(walker);
+    frame->dir = dir;
+    frame->path_length = path_length;
+    frame->depth = depth;
+    walker->dirs_walked++;
+    return DW_CONTINUE;
+}
+
+// Walk everything pushed so far. Returns 1 if on_entry stopped the walk.
+int dwRun(DW_Walker* walker, DW_Callback on_entry, void* user) {
+    const int follow = (walker->flags & DW_FOLLOW_SYMLINKS) != 0;
+    const int open_flags = O_RDONLY | O_DIRECTORY | O_CLOEXEC | (follow ? 0 : O_NOFOLLOW);
+
+    int action = DW_CONTINUE;
+    while (action != DW_STOP) {
+        if (walker->frame_count == 0) {
+            if (walker->pending_head == walker->pending_count) {
+                walker->pending_head = walker->pending_count = 0;
+                break;
+            }
+            DW_Pending next = walker->pending[walker->pending_head++];
+            size_t name_offset;
+            size_t length = dwJoin(walker, 0, next.path, &name_offset, '/');
+            free(next.path);
+            int fd = open(walker->path, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+            if (fd >= 0)
+                action = dwEnterDir(walker, fd, length, dwBaseNameOffset(walker->path, length), next.depth, on_entry, user);
+            continue;
+        }
+
+        DW_Frame* frame = &walker->frames[walker->frame_count - 1];
+        struct dirent* dir_entry = readdir(frame->dir);
+        if (!dir_entry) {
+            closedir(frame->dir);
+            walker->frame_count--;
+            continue;
+        }
+        const char* name = dir_entry->d_name;
+        if (name[0] == '.' && (name[1] == '\0' || (name[1] == '.' && name[2] == '\0')))
+            continue;
+        walker->entries_seen++;
+
+        int parent_fd = dirfd(frame->dir);
+        int depth = frame->depth + 1;
+        size_t parent_length = frame->path_length;
+
+        int is_dir = 0, is_file = 0, needs_stat = 1;
+    #ifdef DT_UNKNOWN
+        switch (dir_entry->d_type) {
+        case DT_DIR: is_dir = 1; needs_stat = 0; break;
+        case DT_REG: is_file = 1; needs_stat = 0; break;
+        case DT_LNK: needs_stat = follow; break;
+        case DT_UNKNOWN: break;
+        default: needs_stat = 0; break; // fifos, sockets, devices
+        }
+    #endif
+        if (needs_stat) {
+            struct stat entry_st;
+            walker->stat_calls++;
+            if (fstatat(parent_fd, name, &entry_st, follow ? 0 : AT_SYMLINK_NOFOLLOW) != 0)
+                continue; // gone, or a dangling symlink
+            is_dir = S_ISDIR(entry_st.st_mode);
+            is_file = S_ISREG(entry_st.st_mode);
+        }
+        if (!is_dir && !is_file)
+            continue;
+
+        size_t name_offset;
+        size_t length = dwJoin(walker, parent_length, name, &name_offset, '/');
+        if (is_dir) {
+            if (depth > walker->max_depth)
+                continue;
+            int fd = openat(parent_fd, name, open_flags);
+            if (fd >= 0)
+                action = dwEnterDir(walker, fd, length, name_offset, depth, on_entry, user);
+        } else {
+            DW_Entry entry;
+            entry.path = walker->path;
+            entry.path_length = length;
+            entry.name = walker->path + name_offset;
+            entry.type = DW_FILE;
+            entry.depth = depth;
+            entry.mtime = 0;
+            entry.walker = walker;
+            action = on_entry(&entry, user);
+        }
+    }
+
+    if (action == DW_STOP) {
+        dwCloseFrames(walker);
+        return 1;
+    }
+    return 0;
+}
+
+#endif
+
+void dwDestroy(DW_Walker* walker) {
+    dwCloseFrames(walker);
+    dwClosePending(walker);
+    free(walker->pending);
+    free(walker->frames);
+    free(walker->path);
+#ifndef _WIN32
+    free(walker->visited);
+#endif
+    memset(walker, 0, sizeof(*walker));
+}
+
+#endif // DW_H_
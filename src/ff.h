@@ -3,20 +3,44 @@
 #define FF_H_
 
 #define FF_PATH_MAX 512
+#define FF_CACHE_MAGIC "FFCACHE 1"
+#define FF_NAME_MAX 128
 
+#include <stddef.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 
+#include "dw.h"
+
 typedef struct FF_StringArray FF_StringArray;
 void ffStringArrayInit(FF_StringArray* strct, size_t initialCapacity);
 void ffStringArrayAppend(FF_StringArray* strct, const char* str);
 void ffStringArrayDestroy(FF_StringArray* strct);
 void ffStringArrayPrintList(FF_StringArray* strct);
+
+// Called for every font file found. Return nonzero to stop the search.
+typedef int (*FF_FontCallback)(const char* font_path, void* user);
+
+typedef struct FF_DirListing FF_DirListing;
+typedef struct FF_FontCache FF_FontCache;
+
 static int ffIsFontFile(const char* file_name);
-static void ffScanDir(const char* path, FF_StringArray* out);
 void ffGetPlatformFontDirs(FF_StringArray* dirs);
 int ffFindFonts(const FF_StringArray* dirs, FF_StringArray* out);
+int ffFindFontsEach(const FF_StringArray* dirs, FF_FontCallback on_font, void* user);
+
+void ffFontCacheInit(FF_FontCache* cache);
+int ffFontCacheLoad(FF_FontCache* cache, const char* cache_path);
+int ffFontCacheSave(FF_FontCache* cache, const char* cache_path);
+void ffFontCacheDestroy(FF_FontCache* cache);
+int ffDefaultCachePath(const char* file_name, char* out, size_t out_size);
+int ffFindFontsCached(const FF_StringArray* dirs, FF_FontCache* cache, FF_FontCallback on_font, void* user);
+
+typedef struct FF_FontNames FF_FontNames;
+int ffParseFontNames(const unsigned char* data, size_t size, FF_FontNames* out);
+void ffFontNamesFromPath(const char* font_path, FF_FontNames* out);
 
 // Implementation:
 
@@ -65,12 +89,29 @@ void ffStringArrayPrintList(FF_StringArray* strct) {
     }
 }
 
+// Direct contents of one directory: its font files and its subdirectories,
+// both as full paths.
+typedef struct FF_DirListing {
+    FF_StringArray fonts;
+    FF_StringArray subdirs;
+} FF_DirListing;
+
+static void ffDirListingInit(FF_DirListing* listing) {
+    ffStringArrayInit(&listing->fonts, 0);
+    ffStringArrayInit(&listing->subdirs, 0);
+}
+
+static void ffDirListingDestroy(FF_DirListing* listing) {
+    ffStringArrayDestroy(&listing->fonts);
+    ffStringArrayDestroy(&listing->subdirs);
+}
+
 #ifdef __WIN32
     #include <Shlobj.h>
     #include <windows.h>
 
 static int ffIsFontFile(const char* file_name) {
-    const char* ext = strchr(file_name, '.');
+    const char* ext = strrchr(file_name, '.');
     if (!ext)
         return 0;
     ext++;
@@ -87,34 +128,6 @@ static int ffIsFontFile(const char* file_name) {
     return 0;
 }
 
-static void ffScanDir(const char* path, FF_StringArray* out) {
-    char search_path[FF_PATH_MAX];
-    WIN32_FIND_DATAA file_data;
-    HANDLE file_handle = INVALID_HANDLE_VALUE;
-
-    snprintf(search_path, FF_PATH_MAX, "%s\\*.*", path);
-    file_handle = FindFirstFileA(search_path, &file_data);
-
-    if (file_handle == INVALID_HANDLE_VALUE)
-        return; // TODO: return error here!
-
-    do {
-        if (strcmp(file_data.cFileName, ".") == 0 || strcmp(file_data.cFileName, "..") == 0)
-            continue;
-
-        char some_full_path[FF_PATH_MAX];
-        snprintf(some_full_path, FF_PATH_MAX, "%s\\%s", path, file_data.cFileName);
-
-        if (file_data.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) {
-            ffScanDir(some_full_path, out);
-        } else if (ffIsFontFile(file_data.cFileName)) {
-            ffStringArrayAppend(out, some_full_path);
-        }
-    } while (FindNextFileA(file_handle, &file_data));
-
-    FindClose(file_handle);
-}
-
 void ffGetPlatformFontDirs(FF_StringArray* dirs) {
     PWSTR fonts_dir = NULL;
     if (SUCCEEDED(SHGetKnownFolderPath(&FOLDERID_Fonts, 0, NULL, &fonts_dir))) {
@@ -134,11 +147,10 @@ void ffGetPlatformFontDirs(FF_StringArray* dirs) {
 }
 
 #else
-    #include <dirent.h>
     #include <sys/stat.h>
 
 static int ffIsFontFile(const char* file_name) {
-    const char* ext = strchr(file_name, '.');
+    const char* ext = strrchr(file_name, '.');
     if (!ext)
         return 0;
     ext++;
@@ -155,38 +167,6 @@ static int ffIsFontFile(const char* file_name) {
     return 0;
 }
 
-static void ffScanDir(const char* path, FF_StringArray* out) {
-    DIR* dir_stream = opendir(path);
-    if (!dir_stream)
-        return; // TODO: return error here!
-
-    struct dirent* dir_entry;
-    struct stat file_st;
-    char some_full_path[FF_PATH_MAX];
-
-    while ((dir_entry = readdir(dir_stream))) {
-        if ((strcmp(dir_entry->d_name, ".") == 0) || strcmp(dir_entry->d_name, "..") == 0)
-            continue;
-
-        size_t dir_path_len = strlen(path);
-        if (path[dir_path_len - 1] == '/')
-            snprintf(some_full_path, FF_PATH_MAX, "%s%s", path, dir_entry->d_name);
-        else
-            snprintf(some_full_path, FF_PATH_MAX, "%s/%s", path, dir_entry->d_name);
-
-        if (stat(some_full_path, &file_st) != 0)
-            continue; // if no file-sys, skip
-
-        if (S_ISDIR(file_st.st_mode)) {
-            ffScanDir(some_full_path, out);
-        } else if ((S_ISREG(file_st.st_mode)) && (ffIsFontFile(dir_entry->d_name))) {
-            ffStringArrayAppend(out, some_full_path);
-        }
-    }
-
-    closedir(dir_stream);
-}
-
 void ffGetPlatformFontDirs(FF_StringArray* dirs) {
     ffStringArrayAppend(dirs, "/usr/share/fonts");
     ffStringArrayAppend(dirs, "/usr/local/share/fonts");
@@ -211,10 +191,527 @@ void ffGetPlatformFontDirs(FF_StringArray* dirs) {
 
 #endif
 
-int ffFindFonts(const FF_StringArray* dirs, FF_StringArray* out) {
+// Listings of the directories seen by the last walk, keyed by path and
+// validated by the directory's mtime, so an unchanged font tree costs one
+// open per directory instead of a full walk.
+typedef struct {
+    char* path;
+    long long mtime;
+    FF_DirListing listing;
+    int seen;  // visited by the current walk
+    int fresh; // listing is being (re)read by the current walk
+} FF_CachedDir;
+
+typedef struct FF_FontCache {
+    FF_CachedDir* dirs;
+    size_t size;
+    size_t capacity;
+    size_t* slots; // open addressing index into dirs, (size_t)-1 for empty
+    size_t slot_count;
+} FF_FontCache;
+
+static size_t ffHashPath(const char* path, size_t length) {
+    size_t hash = 2166136261u;
+    for (size_t i = 0; i < length; i++)
+        hash = (hash ^ (unsigned char)path[i]) * 16777619u;
+    return hash;
+}
+
+static void ffFontCacheReindex(FF_FontCache* cache) {
+    free(cache->slots);
+    cache->slot_count = 16;
+    while (cache->slot_count < cache->capacity * 2)
+        cache->slot_count *= 2;
+    cache->slots = malloc(cache->slot_count * sizeof(size_t));
+    if (!cache->slots)
+        abort();
+    memset(cache->slots, 0xff, cache->slot_count * sizeof(size_t));
+    for (size_t i = 0; i < cache->size; i++) {
+        size_t slot = ffHashPath(cache->dirs[i].path, strlen(cache->dirs[i].path)) & (cache->slot_count - 1);
+        while (cache->slots[slot] != (size_t)-1)
+            slot = (slot + 1) & (cache->slot_count - 1);
+        cache->slots[slot] = i;
+    }
+}
+
+// path doesn't need to be NUL terminated at length.
+static FF_CachedDir* ffFontCacheFind(FF_FontCache* cache, const char* path, size_t length) {
+    if (!cache->slots)
+        return NULL;
+    size_t slot = ffHashPath(path, length) & (cache->slot_count - 1);
+    while (cache->slots[slot] != (size_t)-1) {
+        FF_CachedDir* dir = &cache->dirs[cache->slots[slot]];
+        if (strncmp(dir->path, path, length) == 0 && dir->path[length] == '\0')
+            return dir;
+        slot = (slot + 1) & (cache->slot_count - 1);
+    }
+    return NULL;
+}
+
+static FF_CachedDir* ffFontCacheAdd(FF_FontCache* cache, const char* path, long long mtime) {
+    if (cache->capacity < cache->size + 1) {
+        size_t newCap = cache->capacity ? cache->capacity * 2 : 64;
+        FF_CachedDir* tmp = realloc(cache->dirs, newCap * sizeof(FF_CachedDir));
+        if (!tmp)
+            abort();
+        cache->dirs = tmp;
+        cache->capacity = newCap;
+    }
+    FF_CachedDir* dir = &cache->dirs[cache->size++];
+    dir->path = strdup(path);
+    dir->mtime = mtime;
+    dir->seen = 0;
+    dir->fresh = 0;
+    ffDirListingInit(&dir->listing);
+    if (cache->slot_count < cache->capacity * 2) {
+        ffFontCacheReindex(cache);
+    } else {
+        size_t slot = ffHashPath(path, strlen(path)) & (cache->slot_count - 1);
+        while (cache->slots[slot] != (size_t)-1)
+            slot = (slot + 1) & (cache->slot_count - 1);
+        cache->slots[slot] = cache->size - 1;
+    }
+    return dir;
+}
+
+void ffFontCacheInit(FF_FontCache* cache) {
+    memset(cache, 0, sizeof(*cache));
+}
+
+void ffFontCacheDestroy(FF_FontCache* cache) {
+    for (size_t i = 0; i < cache->size; i++) {
+        free(cache->dirs[i].path);
+        ffDirListingDestroy(&cache->dirs[i].listing);
+    }
+    free(cache->dirs);
+    free(cache->slots);
+    memset(cache, 0, sizeof(*cache));
+}
+
+// Forget the directories the last complete walk didn't reach (deleted, or no
+// longer under the searched dirs).
+static void ffFontCachePrune(FF_FontCache* cache) {
+    size_t kept = 0;
+    for (size_t i = 0; i < cache->size; i++) {
+        if (cache->dirs[i].seen) {
+            cache->dirs[kept++] = cache->dirs[i];
+        } else {
+            free(cache->dirs[i].path);
+            ffDirListingDestroy(&cache->dirs[i].listing);
+        }
+    }
+    cache->size = kept;
+    ffFontCacheReindex(cache);
+}
+
+// The cache file is plain text, one record per line:
+//   D <mtime> <dir path>   a directory, followed by its
+//   F <font path>          font files and
+//   S <subdir path>        subdirectories
+// Returns -1 (and leaves the cache empty) if the file is missing or unreadable.
+int ffFontCacheLoad(FF_FontCache* cache, const char* cache_path) {
+    FILE* file = fopen(cache_path, "r");
+    if (!file)
+        return -1;
+
+    char line[FF_PATH_MAX + 32];
+    if (!fgets(line, sizeof(line), file) || strcmp(line, FF_CACHE_MAGIC "\n") != 0) {
+        fclose(file);
+        return -1;
+    }
+
+    FF_CachedDir* dir = NULL;
+    int ok = 1;
+    while (ok && fgets(line, sizeof(line), file)) {
+        size_t len = strlen(line);
+        if (len == 0 || line[len - 1] != '\n') { // truncated
+            ok = 0;
+            break;
+        }
+        line[len - 1] = '\0';
+
+        if (line[0] == 'D' && line[1] == ' ') {
+            char* path = NULL;
+            long long mtime = strtoll(line + 2, &path, 10);
+            if (!path || *path != ' ' || ffFontCacheFind(cache, path + 1, strlen(path + 1))) {
+                ok = 0;
+                break;
+            }
+            dir = ffFontCacheAdd(cache, path + 1, mtime);
+        } else if (dir && line[0] == 'F' && line[1] == ' ') {
+            ffStringArrayAppend(&dir->listing.fonts, line + 2);
+        } else if (dir && line[0] == 'S' && line[1] == ' ') {
+            ffStringArrayAppend(&dir->listing.subdirs, line + 2);
+        } else {
+            ok = 0;
+        }
+    }
+    fclose(file);
+
+    if (!ok) {
+        ffFontCacheDestroy(cache);
+        return -1;
+    }
+    return 0;
+}
+
+// Written to a temporary file first and renamed over cache_path, so readers
+// never see half a cache.
+int ffFontCacheSave(FF_FontCache* cache, const char* cache_path) {
+    char tmp_path[FF_PATH_MAX];
+    if (snprintf(tmp_path, FF_PATH_MAX, "%s.tmp", cache_path) >= FF_PATH_MAX)
+        return -1;
+
+    FILE* file = fopen(tmp_path, "w");
+    if (!file)
+        return -1;
+
+    fprintf(file, FF_CACHE_MAGIC "\n");
+    for (size_t i = 0; i < cache->size; i++) {
+        FF_CachedDir* dir = &cache->dirs[i];
+        fprintf(file, "D %lld %s\n", dir->mtime, dir->path);
+        for (size_t j = 0; j < dir->listing.fonts.size; j++)
+            fprintf(file, "F %s\n", dir->listing.fonts.items[j]);
+        for (size_t j = 0; j < dir->listing.subdirs.size; j++)
+            fprintf(file, "S %s\n", dir->listing.subdirs.items[j]);
+    }
+    if (fclose(file) != 0) {
+        remove(tmp_path);
+        return -1;
+    }
+#ifdef __WIN32
+    remove(cache_path); // rename() doesn't replace on Windows
+#endif
+    return rename(tmp_path, cache_path);
+}
+
+// $XDG_CACHE_HOME/<file_name>, falling back to ~/.cache (%LOCALAPPDATA% on
+// Windows). The cache directory is created if needed.
+int ffDefaultCachePath(const char* file_name, char* out, size_t out_size) {
+    char cache_dir[FF_PATH_MAX];
+#ifdef __WIN32
+    const char* local = getenv("LOCALAPPDATA");
+    if (!local)
+        return -1;
+    snprintf(cache_dir, FF_PATH_MAX, "%s", local);
+#else
+    const char* xdg_cache_home = getenv("XDG_CACHE_HOME");
+    if (xdg_cache_home && xdg_cache_home[0] == '/') {
+        snprintf(cache_dir, FF_PATH_MAX, "%s", xdg_cache_home);
+    } else {
+        const char* home = getenv("HOME");
+        if (!home)
+            return -1;
+        snprintf(cache_dir, FF_PATH_MAX, "%s/.cache", home);
+    }
+    mkdir(cache_dir, 0700); // fine if it exists
+#endif
+    if ((size_t)snprintf(out, out_size, "%s/%s", cache_dir, file_name) >= out_size)
+        return -1;
+    return 0;
+}
+
+typedef struct {
+    FF_FontCache* cache; // NULL for a plain walk
+    FF_FontCallback on_font;
+    void* user;
+} FF_WalkState;
+
+// The cache entry of the directory entry sits in, if that directory is being
+// read (as opposed to replayed from the cache).
+static FF_CachedDir* ffFreshParent(FF_FontCache* cache, const DW_Entry* entry) {
+    size_t parent_length = (size_t)(entry->name - entry->path);
+    if (parent_length > 1)
+        parent_length--; // the separator, unless the parent is "/"
+    FF_CachedDir* parent = ffFontCacheFind(cache, entry->path, parent_length);
+    return (parent && parent->fresh) ? parent : NULL;
+}
+
+static int ffWalkEntry(const DW_Entry* entry, void* user) {
+    FF_WalkState* state = (FF_WalkState*)user;
+    FF_FontCache* cache = state->cache;
+
+    if (entry->type == DW_FILE) {
+        if (!ffIsFontFile(entry->name))
+            return DW_CONTINUE;
+        FF_CachedDir* parent = cache ? ffFreshParent(cache, entry) : NULL;
+        if (parent)
+            ffStringArrayAppend(&parent->listing.fonts, entry->path);
+        return state->on_font(entry->path, state->user) ? DW_STOP : DW_CONTINUE;
+    }
+
+    if (!cache)
+        return DW_CONTINUE;
+    FF_CachedDir* parent = entry->depth > 0 ? ffFreshParent(cache, entry) : NULL;
+    if (parent)
+        ffStringArrayAppend(&parent->listing.subdirs, entry->path);
+
+    FF_CachedDir* cached = ffFontCacheFind(cache, entry->path, entry->path_length);
+    if (cached && cached->seen)
+        return DW_SKIP; // already walked (e.g. the same dir listed twice)
+
+    if (cached && cached->mtime == entry->mtime) {
+        cached->seen = 1;
+        for (size_t i = 0; i < cached->listing.fonts.size; i++) {
+            if (state->on_font(cached->listing.fonts.items[i], state->user))
+                return DW_STOP;
+        }
+        for (size_t i = 0; i < cached->listing.subdirs.size; i++)
+            dwPush(entry->walker, cached->listing.subdirs.items[i], entry->depth + 1);
+        return DW_SKIP;
+    }
+
+    if (!cached) {
+        cached = ffFontCacheAdd(cache, entry->path, entry->mtime);
+    } else {
+        ffDirListingDestroy(&cached->listing);
+        ffDirListingInit(&cached->listing);
+        cached->mtime = entry->mtime;
+    }
+    cached->seen = 1;
+    cached->fresh = 1;
+    return DW_CONTINUE;
+}
+
+// Like ffFindFontsEach, but directories whose mtime matches the cache are not
+// read again. The cache is updated with what the walk found and, when the
+// walk wasn't stopped, pruned of directories that are gone. cache may be NULL.
+int ffFindFontsCached(const FF_StringArray* dirs, FF_FontCache* cache, FF_FontCallback on_font, void* user) {
+    if (cache) {
+        for (size_t i = 0; i < cache->size; i++)
+            cache->dirs[i].seen = cache->dirs[i].fresh = 0;
+    }
+
+    FF_WalkState state = {cache, on_font, user};
+    DW_Walker walker;
+    dwInit(&walker, DW_FOLLOW_SYMLINKS, DW_DEFAULT_MAX_DEPTH);
     for (size_t i = 0; i < dirs->size; i++)
-        ffScanDir(dirs->items[i], out);
+        dwPush(&walker, dirs->items[i], 0);
+    int stopped = dwRun(&walker, ffWalkEntry, &state);
+    dwDestroy(&walker);
+
+    if (cache && !stopped)
+        ffFontCachePrune(cache);
+    return stopped;
+}
+
+// Report fonts to on_font as the directories are walked, so a caller can show
+// them before the search is over. Returns 1 if on_font stopped the search.
+int ffFindFontsEach(const FF_StringArray* dirs, FF_FontCallback on_font, void* user) {
+    return ffFindFontsCached(dirs, NULL, on_font, user);
+}
+
+static int ffAppendFont(const char* font_path, void* user) {
+    ffStringArrayAppend((FF_StringArray*)user, font_path);
     return 0;
 }
 
+int ffFindFonts(const FF_StringArray* dirs, FF_StringArray* out) {
+    return ffFindFontsEach(dirs, ffAppendFont, out);
+}
+
+// Family ("Source Code Pro") and style ("Bold Italic") of a font, UTF-8.
+typedef struct FF_FontNames {
+    char family[FF_NAME_MAX];
+    char style[FF_NAME_MAX];
+} FF_FontNames;
+
+static uint16_t ffRead16(const unsigned char* bytes) {
+    return (uint16_t)(bytes[0] << 8 | bytes[1]);
+}
+
+static uint32_t ffRead32(const unsigned char* bytes) {
+    return (uint32_t)bytes[0] << 24 | (uint32_t)bytes[1] << 16 | (uint32_t)bytes[2] << 8 | bytes[3];
+}
+
+#define FF_TAG(a, b, c, d) ((uint32_t)(a) << 24 | (uint32_t)(b) << 16 | (uint32_t)(c) << 8 | (uint32_t)(d))
+
+// Locate an uncompressed table in a TrueType/OpenType font, the first font
+// of a collection, or a WOFF file that stored the table as is.
+static int ffFindTable(const unsigned char* data, size_t size, uint32_t tag, size_t* table_offset, size_t* table_length) {
+    if (size < 12)
+        return -1;
+
+    size_t font_offset = 0;
+    uint32_t sfnt_version = ffRead32(data);
+    if (sfnt_version == FF_TAG('t', 't', 'c', 'f')) {
+        if (size < 16)
+            return -1;
+        font_offset = ffRead32(data + 12);
+        if (font_offset > size - 12)
+            return -1;
+        sfnt_version = ffRead32(data + font_offset);
+    }
+
+    if (sfnt_version == FF_TAG('w', 'O', 'F', 'F')) {
+        if (size < 44)
+            return -1;
+        size_t table_count = ffRead16(data + 12);
+        if (table_count > (size - 44) / 20)
+            return -1;
+        for (size_t i = 0; i < table_count; i++) {
+            const unsigned char* record = data + 44 + i * 20;
+            if (ffRead32(record) != tag)
+                continue;
+            size_t offset = ffRead32(record + 4), stored_length = ffRead32(record + 8), length = ffRead32(record + 12);
+            if (stored_length != length || offset > size || length > size - offset)
+                return -1; // zlib compressed
+            *table_offset = offset;
+            *table_length = length;
+            return 0;
+        }
+        return -1;
+    }
+
+    if (sfnt_version != 0x00010000 && sfnt_version != FF_TAG('O', 'T', 'T', 'O') && sfnt_version != FF_TAG('t', 'r', 'u', 'e'))
+        return -1; // WOFF2 and anything else
+    size_t table_count = ffRead16(data + font_offset + 4);
+    if (table_count > (size - font_offset - 12) / 16)
+        return -1;
+    for (size_t i = 0; i < table_count; i++) {
+        const unsigned char* record = data + font_offset + 12 + i * 16;
+        if (ffRead32(record) != tag)
+            continue;
+        size_t offset = ffRead32(record + 8), length = ffRead32(record + 12);
+        if (offset > size || length > size - offset)
+            return -1;
+        *table_offset = offset;
+        *table_length = length;
+        return 0;
+    }
+    return -1;
+}
+
+static size_t ffPutUtf8(char* out, size_t out_size, size_t at, uint32_t code_point) {
+    char encoded[4];
+    size_t length;
+    if (code_point < 0x80) {
+        encoded[0] = (char)code_point;
+        length = 1;
+    } else if (code_point < 0x800) {
+        encoded[0] = (char)(0xC0 | code_point >> 6);
+        encoded[1] = (char)(0x80 | (code_point & 0x3F));
+        length = 2;
+    } else if (code_point < 0x10000) {
+        encoded[0] = (char)(0xE0 | code_point >> 12);
+        encoded[1] = (char)(0x80 | (code_point >> 6 & 0x3F));
+        encoded[2] = (char)(0x80 | (code_point & 0x3F));
+        length = 3;
+    } else {
+        encoded[0] = (char)(0xF0 | code_point >> 18);
+        encoded[1] = (char)(0x80 | (code_point >> 12 & 0x3F));
+        encoded[2] = (char)(0x80 | (code_point >> 6 & 0x3F));
+        encoded[3] = (char)(0x80 | (code_point & 0x3F));
+        length = 4;
+    }
+    if (at + length >= out_size)
+        return at; // doesn't fit, drop the rest
+    memcpy(out + at, encoded, length);
+    return at + length;
+}
+
+// Name strings are UTF-16BE, except for Mac Roman on the Macintosh platform
+// (only its ASCII half is kept).
+static void ffDecodeName(const unsigned char* str, size_t length, int utf16, char* out, size_t out_size) {
+    size_t at = 0;
+    if (!utf16) {
+        for (size_t i = 0; i < length; i++)
+            at = ffPutUtf8(out, out_size, at, str[i] < 0x80 ? str[i] : '?');
+    } else {
+        for (size_t i = 0; i + 1 < length; i += 2) {
+            uint32_t code_point = ffRead16(str + i);
+            if (code_point >= 0xD800 && code_point < 0xDC00 && i + 3 < length) {
+                uint32_t low = ffRead16(str + i + 2);
+                if (low >= 0xDC00 && low < 0xE000) {
+                    code_point = 0x10000 + ((code_point - 0xD800) << 10) + (low - 0xDC00);
+                    i += 2;
+                }
+            }
+            at = ffPutUtf8(out, out_size, at, code_point);
+        }
+    }
+    out[at] = '\0';
+}
+
+// How much a name record is preferred, -1 for encodings we can't read.
+static int ffNameRecordScore(uint16_t platform, uint16_t encoding, uint16_t language) {
+    if (platform == 3 && (encoding == 1 || encoding == 10))
+        return language == 0x409 ? 4 : 3; // Windows Unicode, US English first
+    if (platform == 0)
+        return 2;
+    if (platform == 1 && encoding == 0)
+        return language == 0 ? 1 : -1; // Macintosh Roman English
+    return -1;
+}
+
+// Read the family and style names from the font's `name` table. The
+// typographic names (IDs 16 and 17) win over the legacy ones (1 and 2), which
+// split big families into "Foo", "Foo Light", "Foo Medium"...
+// Returns -1 when there is no readable family name.
+int ffParseFontNames(const unsigned char* data, size_t size, FF_FontNames* out) {
+    memset(out, 0, sizeof(*out));
+    size_t table_offset, table_length;
+    if (ffFindTable(data, size, FF_TAG('n', 'a', 'm', 'e'), &table_offset, &table_length) != 0 || table_length < 6)
+        return -1;
+
+    const unsigned char* table = data + table_offset;
+    size_t record_count = ffRead16(table + 2);
+    size_t strings_offset = ffRead16(table + 4);
+    if (record_count > (table_length - 6) / 12 || strings_offset > table_length)
+        return -1;
+
+    enum { FAMILY, STYLE, TYPOGRAPHIC_FAMILY, TYPOGRAPHIC_STYLE, NAME_KINDS };
+    const unsigned char* best[NAME_KINDS] = {0};
+    size_t best_length[NAME_KINDS] = {0};
+    int best_utf16[NAME_KINDS] = {0};
+    int best_score[NAME_KINDS] = {-1, -1, -1, -1};
+
+    for (size_t i = 0; i < record_count; i++) {
+        const unsigned char* record = table + 6 + i * 12;
+        int kind;
+        switch (ffRead16(record + 6)) {
+        case 1: kind = FAMILY; break;
+        case 2: kind = STYLE; break;
+        case 16: kind = TYPOGRAPHIC_FAMILY; break;
+        case 17: kind = TYPOGRAPHIC_STYLE; break;
+        default: continue;
+        }
+        uint16_t platform = ffRead16(record);
+        int score = ffNameRecordScore(platform, ffRead16(record + 2), ffRead16(record + 4));
+        size_t length = ffRead16(record + 8), offset = strings_offset + ffRead16(record + 10);
+        if (score <= best_score[kind] || length == 0 || offset > table_length || length > table_length - offset)
+            continue;
+        best[kind] = table + offset;
+        best_length[kind] = length;
+        best_utf16[kind] = platform != 1;
+        best_score[kind] = score;
+    }
+
+    int family = best[TYPOGRAPHIC_FAMILY] ? TYPOGRAPHIC_FAMILY : FAMILY;
+    int style = best[TYPOGRAPHIC_STYLE] ? TYPOGRAPHIC_STYLE : STYLE;
+    if (!best[family])
+        return -1;
+    ffDecodeName(best[family], best_length[family], best_utf16[family], out->family, sizeof(out->family));
+    if (best[style])
+        ffDecodeName(best[style], best_length[style], best_utf16[style], out->style, sizeof(out->style));
+    return out->family[0] ? 0 : -1;
+}
+
+// For fonts whose names can't be read (WOFF2, compressed WOFF): the file
+// name without its extension, with no style.
+void ffFontNamesFromPath(const char* font_path, FF_FontNames* out) {
+    memset(out, 0, sizeof(*out));
+    const char* name = font_path;
+    for (const char* ch = font_path; *ch; ch++) {
+        if (*ch == '/' || *ch == '\\')
+            name = ch + 1;
+    }
+    const char* ext = strrchr(name, '.');
+    size_t length = ext && ext != name ? (size_t)(ext - name) : strlen(name);
+    if (length >= sizeof(out->family))
+        length = sizeof(out->family) - 1;
+    memcpy(out->family, name, length);
+    out->family[length] = '\0';
+}
+
 #endif // FF_H_
@@ -0,0 +1,361 @@
+// clang-format Language: C
+#ifndef FW_H_
+#define FW_H_
+
+#define FW_PATH_MAX 512
+
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <time.h>
+
+typedef struct FW_Watcher FW_Watcher;
+void fwInit(FW_Watcher* watcher);
+void fwDestroy(FW_Watcher* watcher);
+size_t fwWatchPath(FW_Watcher* watcher, const char* path);
+void fwUnwatchAll(FW_Watcher* watcher);
+size_t fwPoll(FW_Watcher* watcher);
+void fwWait(FW_Watcher* watcher, int timeout_ms);
+void fwWakeup(FW_Watcher* watcher);
+bool fwTakeChanged(FW_Watcher* watcher, size_t id);
+bool fwIsPolling(const FW_Watcher* watcher);
+
+// Implementation:
+
+// A watched file. Files are watched through their parent directory, so that
+// editors saving via "write temp file + rename over the original" are caught
+// (a watch on the file itself would stay glued to the old, unlinked inode).
+typedef struct FW_Entry {
+    char path[FW_PATH_MAX];
+    size_t name_offset; // basename, offset into path
+    size_t dir;         // index into FW_Watcher.dirs
+    bool polled;        // no usable inotify watch, fall back to stat()
+    bool exists;
+    time_t mtime;
+    off_t size;
+    bool pending; // inotify reported an event, not yet folded into changed
+    bool changed;
+} FW_Entry;
+
+typedef struct FW_Dir {
+    char path[FW_PATH_MAX];
+    int wd; // -1 when not (or no longer) watched
+} FW_Dir;
+
+typedef struct FW_Watcher {
+    int fd;          // inotify instance, -1 when unavailable (stat polling only)
+    int wake_fds[2]; // self-pipe used by fwWakeup() to interrupt fwWait()
+    FW_Entry* entries;
+    size_t size;
+    size_t capacity;
+    FW_Dir* dirs;
+    size_t dirs_size;
+    size_t dirs_capacity;
+} FW_Watcher;
+
+static void fwStatEntry(FW_Entry* entry, bool* exists, time_t* mtime, off_t* size) {
+    struct stat file_st;
+    if (stat(entry->path, &file_st) == 0) {
+        *exists = true;
+        *mtime = file_st.st_mtime;
+        *size = file_st.st_size;
+    } else {
+        *exists = false;
+        *mtime = 0;
+        *size = 0;
+    }
+}
+
+static void fwSplitPath(const char* path, char* dir_out, const char** name_out) {
+    const char* slash = strrchr(path, '/');
+#ifdef _WIN32
+    const char* backslash = strrchr(path, '\\');
+    if (!slash || (backslash && backslash > slash))
+        slash = backslash;
+#endif
+    if (!slash) {
+        snprintf(dir_out, FW_PATH_MAX, ".");
+        *name_out = path;
+    } else if (slash == path) {
+        snprintf(dir_out, FW_PATH_MAX, "/");
+        *name_out = slash + 1;
+    } else {
+        snprintf(dir_out, FW_PATH_MAX, "%.*s", (int)(slash - path), path);
+        *name_out = slash + 1;
+    }
+}
+
+static void fwMarkDir(FW_Watcher* watcher, size_t dir, const char* name) {
+    for (size_t i = 0; i < watcher->size; i++) {
+        FW_Entry* entry = &watcher->entries[i];
+        if (entry->dir != dir)
+            continue;
+        if (name && strcmp(entry->path + entry->name_offset, name) != 0)
+            continue;
+        entry->pending = true;
+    }
+}
+
+#ifdef _WIN32
+    #include <windows.h>
+#else
+    #include <fcntl.h>
+    #include <poll.h>
+    #include <unistd.h>
+#endif
+
+#ifdef __linux__
+    #include <sys/inotify.h>
+
+    #define FW_DIR_EVENTS (IN_MODIFY | IN_CLOSE_WRITE | IN_ATTRIB | IN_CREATE | IN_DELETE | IN_MOVED_FROM | IN_MOVED_TO)
+
+static int fwOpen(void) {
+    return inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+}
+
+static int fwAddDirWatch(FW_Watcher* watcher, const char* dir_path) {
+    if (watcher->fd < 0)
+        return -1;
+    return inotify_add_watch(watcher->fd, dir_path, FW_DIR_EVENTS);
+}
+
+static void fwRemoveDirWatch(FW_Watcher* watcher, int wd) {
+    if (watcher->fd >= 0 && wd >= 0)
+        inotify_rm_watch(watcher->fd, wd);
+}
+
+// Drain every pending inotify event, marking the entries they name.
+static void fwReadEvents(FW_Watcher* watcher) {
+    char buffer[4096] __attribute__((aligned(__alignof__(struct inotify_event))));
+
+    for (;;) {
+        ssize_t length = read(watcher->fd, buffer, sizeof(buffer));
+        if (length <= 0)
+            break; // EAGAIN: queue is empty
+
+        for (char* ptr = buffer; ptr < buffer + length;) {
+            const struct inotify_event* event = (const struct inotify_event*)ptr;
+            ptr += sizeof(struct inotify_event) + event->len;
+
+            if (event->mask & IN_Q_OVERFLOW) { // events were dropped, assume everything changed
+                for (size_t i = 0; i < watcher->size; i++)
+                    watcher->entries[i].pending = true;
+                continue;
+            }
+
+            for (size_t d = 0; d < watcher->dirs_size; d++) {
+                if (watcher->dirs[d].wd != event->wd)
+                    continue;
+                if (event->mask & IN_IGNORED) { // directory went away, its files did too
+                    watcher->dirs[d].wd = -1;
+                    fwMarkDir(watcher, d, NULL);
+                } else if (event->len > 0) {
+                    fwMarkDir(watcher, d, event->name);
+                }
+            }
+        }
+    }
+}
+
+#else
+
+static int fwOpen(void) {
+    return -1;
+}
+
+static int fwAddDirWatch(FW_Watcher* watcher __attribute__((unused)), const char* dir_path __attribute__((unused))) {
+    return -1;
+}
+
+static void fwRemoveDirWatch(FW_Watcher* watcher __attribute__((unused)), int wd __attribute__((unused))) {
+}
+
+static void fwReadEvents(FW_Watcher* watcher __attribute__((unused))) {
+}
+
+#endif
+
+void fwInit(FW_Watcher* watcher) {
+    memset(watcher, 0, sizeof(*watcher));
+    watcher->fd = fwOpen();
+    watcher->wake_fds[0] = watcher->wake_fds[1] = -1;
+#ifndef _WIN32
+    if (pipe(watcher->wake_fds) == 0) {
+        fcntl(watcher->wake_fds[0], F_SETFL, O_NONBLOCK);
+        fcntl(watcher->wake_fds[1], F_SETFL, O_NONBLOCK);
+    } else {
+        watcher->wake_fds[0] = watcher->wake_fds[1] = -1;
+    }
+#endif
+}
+
+void fwDestroy(FW_Watcher* watcher) {
+    fwUnwatchAll(watcher);
+#ifndef _WIN32
+    if (watcher->fd >= 0)
+        close(watcher->fd);
+    if (watcher->wake_fds[0] >= 0) {
+        close(watcher->wake_fds[0]);
+        close(watcher->wake_fds[1]);
+    }
+#endif
+    free(watcher->entries);
+    free(watcher->dirs);
+    memset(watcher, 0, sizeof(*watcher));
+    watcher->fd = -1;
+    watcher->wake_fds[0] = watcher->wake_fds[1] = -1;
+}
+
+static size_t fwFindOrAddDir(FW_Watcher* watcher, const char* dir_path) {
+    for (size_t d = 0; d < watcher->dirs_size; d++) {
+        if (strcmp(watcher->dirs[d].path, dir_path) == 0)
+            return d;
+    }
+    if (watcher->dirs_capacity < watcher->dirs_size + 1) {
+        size_t newCap = watcher->dirs_capacity ? watcher->dirs_capacity * 2 : 4;
+        FW_Dir* tmp = realloc(watcher->dirs, newCap * sizeof(FW_Dir));
+        if (!tmp)
+            abort();
+        watcher->dirs = tmp;
+        watcher->dirs_capacity = newCap;
+    }
+    FW_Dir* dir = &watcher->dirs[watcher->dirs_size];
+    snprintf(dir->path, FW_PATH_MAX, "%s", dir_path);
+    dir->wd = fwAddDirWatch(watcher, dir_path);
+    return watcher->dirs_size++;
+}
+
+// Start watching a file. The returned id stays valid until fwUnwatchAll().
+size_t fwWatchPath(FW_Watcher* watcher, const char* path) {
+    if (watcher->capacity < watcher->size + 1) {
+        size_t newCap = watcher->capacity ? watcher->capacity * 2 : 8;
+        FW_Entry* tmp = realloc(watcher->entries, newCap * sizeof(FW_Entry));
+        if (!tmp)
+            abort();
+        watcher->entries = tmp;
+        watcher->capacity = newCap;
+    }
+    FW_Entry* entry = &watcher->entries[watcher->size];
+    memset(entry, 0, sizeof(*entry));
+    snprintf(entry->path, FW_PATH_MAX, "%s", path);
+
+    char dir_path[FW_PATH_MAX];
+    const char* name;
+    fwSplitPath(entry->path, dir_path, &name);
+    entry->name_offset = name - entry->path;
+    entry->dir = fwFindOrAddDir(watcher, dir_path);
+    entry->polled = watcher->dirs[entry->dir].wd < 0;
+    fwStatEntry(entry, &entry->exists, &entry->mtime, &entry->size);
+
+    return watcher->size++;
+}
+
+void fwUnwatchAll(FW_Watcher* watcher) {
+    for (size_t d = 0; d < watcher->dirs_size; d++)
+        fwRemoveDirWatch(watcher, watcher->dirs[d].wd);
+    watcher->dirs_size = 0;
+    watcher->size = 0;
+}
+
+// Collect pending changes without blocking. Returns the number of watched
+// files that got flagged as changed by this call.
+size_t fwPoll(FW_Watcher* watcher) {
+    if (watcher->fd >= 0) {
+        fwReadEvents(watcher);
+
+        // retry directories that were missing (or got removed) earlier
+        for (size_t d = 0; d < watcher->dirs_size; d++) {
+            if (watcher->dirs[d].wd < 0)
+                watcher->dirs[d].wd = fwAddDirWatch(watcher, watcher->dirs[d].path);
+        }
+    }
+
+    size_t changed_count = 0;
+    for (size_t i = 0; i < watcher->size; i++) {
+        FW_Entry* entry = &watcher->entries[i];
+
+        // entries whose directory just got (re)watched are stat'ed one last time
+        if (entry->polled || entry->pending) {
+            bool exists;
+            time_t mtime;
+            off_t size;
+            fwStatEntry(entry, &exists, &mtime, &size);
+            // inotify events are trusted as is, st_mtime only has second resolution
+            if (entry->pending || exists != entry->exists || mtime != entry->mtime || size != entry->size) {
+                if (!entry->changed)
+                    changed_count++;
+                entry->changed = true;
+            }
+            entry->pending = false;
+            entry->exists = exists;
+            entry->mtime = mtime;
+            entry->size = size;
+        }
+        entry->polled = watcher->dirs[entry->dir].wd < 0;
+    }
+    return changed_count;
+}
+
+// Block until inotify has something to report, fwWakeup() is called, or
+// timeout_ms passes (-1 waits forever). Does not touch the watched entries,
+// so it is safe to call without holding whatever lock guards the watcher.
+void fwWait(FW_Watcher* watcher, int timeout_ms) {
+#ifdef _WIN32
+    Sleep(timeout_ms < 0 ? INFINITE : (DWORD)timeout_ms);
+#else
+    struct pollfd fds[2];
+    nfds_t fds_count = 0;
+    if (watcher->wake_fds[0] >= 0) {
+        fds[fds_count].fd = watcher->wake_fds[0];
+        fds[fds_count].events = POLLIN;
+        fds_count++;
+    }
+    if (watcher->fd >= 0) {
+        fds[fds_count].fd = watcher->fd;
+        fds[fds_count].events = POLLIN;
+        fds_count++;
+    }
+    poll(fds, fds_count, timeout_ms);
+
+    char drain[64];
+    if (watcher->wake_fds[0] >= 0) {
+        while (read(watcher->wake_fds[0], drain, sizeof(drain)) > 0) {
+        }
+    }
+#endif
+}
+
+void fwWakeup(FW_Watcher* watcher) {
+#ifndef _WIN32
+    if (watcher->wake_fds[1] >= 0) {
+        char byte = 1;
+        if (write(watcher->wake_fds[1], &byte, 1) < 0) {
+            // pipe full: a wakeup is already pending
+        }
+    }
+#else
+    (void)watcher;
+#endif
+}
+
+// Returns whether the file with this id changed since the last call, and
+// clears the flag.
+bool fwTakeChanged(FW_Watcher* watcher, size_t id) {
+    if (id >= watcher->size || !watcher->entries[id].changed)
+        return false;
+    watcher->entries[id].changed = false;
+    return true;
+}
+
+// True when at least one file can only be observed by stat() polling.
+bool fwIsPolling(const FW_Watcher* watcher) {
+    for (size_t i = 0; i < watcher->size; i++) {
+        if (watcher->entries[i].polled)
+            return true;
+    }
+    return false;
+}
+
+#endif // FW_H_
@@ -0,0 +1,425 @@
+// clang-format Language: C
+#ifndef KS_H_
+#define KS_H_
+
+#define KS_MAX_FIRST_BYTES 16
+
+#include <errno.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+
+#if (defined(__x86_64__) || defined(__i386__)) && defined(__GNUC__)
+    #define KS_X86_KERNELS 1
+    #include <immintrin.h>
+#else
+    #define KS_X86_KERNELS 0
+#endif
+
+// Called for every line that contains at least one keyword first byte. The
+// line excludes its '\n', line_number starts at 1. Return false to stop.
+typedef bool (*KS_LineCallback)(const char* line, size_t length, size_t line_number, void* user);
+
+typedef struct KS_FileData KS_FileData;
+bool ksLoadFile(const char* path, bool use_mmap, KS_FileData* out);
+void ksReleaseFile(KS_FileData* file);
+
+typedef struct KS_Prefilter KS_Prefilter;
+void ksPrefilterInit(KS_Prefilter* pf);
+void ksPrefilterAddKeyword(KS_Prefilter* pf, const char* keyword);
+void ksPrefilterCompile(KS_Prefilter* pf);
+size_t ksScanLines(const KS_Prefilter* pf, const char* buffer, size_t length, KS_LineCallback on_candidate, void* user);
+const char* ksKernelName(const KS_Prefilter* pf);
+
+void ksTrimItemPrefix(char* text_line);
+void ksTrimKeywordPrefix(char* text_line, const char* keyword);
+
+// Implementation:
+
+// Contents of a file to scan: either a read-only mapping of it, or a heap copy.
+typedef struct KS_FileData {
+    const char* data;
+    size_t size;
+    bool mapped;
+} KS_FileData;
+
+#ifndef _WIN32
+    #include <fcntl.h>
+    #include <sys/mman.h>
+    #include <unistd.h>
+
+// Close fd and fail with error in errno (close() may clobber it).
+static bool ksCloseAndFail(int fd, int error) {
+    close(fd);
+    errno = error;
+    return false;
+}
+
+static bool ksMapFile(const char* path, KS_FileData* out) {
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0)
+        return false;
+
+    struct stat file_st;
+    if (fstat(fd, &file_st) != 0)
+        return ksCloseAndFail(fd, errno);
+    if (!S_ISREG(file_st.st_mode))
+        return ksCloseAndFail(fd, S_ISDIR(file_st.st_mode) ? EISDIR : EINVAL);
+
+    out->size = (size_t)file_st.st_size;
+    out->mapped = true;
+    out->data = "";
+    if (out->size > 0) {
+        void* mapping = mmap(NULL, out->size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (mapping == MAP_FAILED)
+            return ksCloseAndFail(fd, errno);
+        madvise(mapping, out->size, MADV_SEQUENTIAL);
+        out->data = mapping;
+    }
+    close(fd); // the mapping stays valid
+    return true;
+}
+#endif
+
+static bool ksReadFile(const char* path, KS_FileData* out) {
+    FILE* file = fopen(path, "rb");
+    if (!file)
+        return false;
+
+    struct stat file_st;
+    int error = stat(path, &file_st) != 0 ? errno : S_ISDIR(file_st.st_mode) ? EISDIR : 0;
+    if (error) {
+        fclose(file);
+        errno = error;
+        return false;
+    }
+
+    size_t capacity = (size_t)file_st.st_size + 1;
+    char* buffer = malloc(capacity);
+    if (!buffer)
+        abort();
+    size_t size = 0;
+    for (;;) {
+        size += fread(buffer + size, 1, capacity - 1 - size, file);
+        if (size < capacity - 1)
+            break;
+        int next = fgetc(file); // buffer is full, the file may have grown since the stat()
+        if (next == EOF)
+            break;
+        capacity *= 2;
+        buffer = realloc(buffer, capacity);
+        if (!buffer)
+            abort();
+        buffer[size++] = (char)next;
+    }
+    if (ferror(file)) {
+        error = errno;
+        free(buffer);
+        fclose(file);
+        errno = error;
+        return false;
+    }
+    fclose(file);
+
+    buffer[size] = '\0';
+    out->data = buffer;
+    out->size = size;
+    out->mapped = false;
+    return true;
+}
+
+// Load a whole file. With use_mmap the file is mapped read-only instead of
+// copied (POSIX only, the flag is ignored elsewhere). Returns false, with
+// errno telling why, when the file can't be opened or read.
+bool ksLoadFile(const char* path, bool use_mmap, KS_FileData* out) {
+    memset(out, 0, sizeof(*out));
+#ifndef _WIN32
+    if (use_mmap)
+        return ksMapFile(path, out);
+#else
+    (void)use_mmap;
+#endif
+    return ksReadFile(path, out);
+}
+
+void ksReleaseFile(KS_FileData* file) {
+    if (!file->data)
+        return;
+#ifndef _WIN32
+    if (file->mapped) {
+        if (file->size > 0)
+            munmap((void*)file->data, file->size);
+    } else {
+        free((void*)file->data);
+    }
+#else
+    free((void*)file->data);
+#endif
+    memset(file, 0, sizeof(*file));
+}
+
+typedef struct KS_ScanState {
+    const char* buffer;
+    size_t line_start;
+    size_t line_number; // number of the line that starts at line_start
+    bool line_is_candidate;
+    bool stopped;
+    KS_LineCallback on_candidate;
+    void* user;
+} KS_ScanState;
+
+typedef void (*KS_Kernel)(const KS_Prefilter* pf, KS_ScanState* st, size_t length);
+
+// Line splitter + keyword prefilter. Buffers are split on '\n' (empty lines
+// included, the buffer is never written to) and only lines holding one of the
+// keywords' first bytes reach the callback, where the full match is checked.
+// The SIMD kernels test 16 (SSE2) or 32 (AVX2) bytes per step.
+typedef struct KS_Prefilter {
+    unsigned char first_bytes[KS_MAX_FIRST_BYTES];
+    size_t first_bytes_count;
+    bool every_line; // too many distinct first bytes, every non-empty line is a candidate
+    bool is_first_byte[256];
+    KS_Kernel kernel;
+    const char* kernel_name;
+} KS_Prefilter;
+
+static void ksEmitLine(KS_ScanState* st, size_t line_end) {
+    if (!st->on_candidate(st->buffer + st->line_start, line_end - st->line_start, st->line_number, st->user))
+        st->stopped = true;
+}
+
+// Fold one block's newline and candidate bit masks into the line state.
+static inline void ksProcessBlock(KS_ScanState* st, size_t base, uint32_t newline_mask, uint32_t candidate_mask) {
+    if (!st->line_is_candidate && candidate_mask == 0) { // the common case: just count lines
+        if (newline_mask) {
+            st->line_number += __builtin_popcount(newline_mask);
+            st->line_start = base + (31 - __builtin_clz(newline_mask)) + 1;
+        }
+        return;
+    }
+
+    uint32_t events = newline_mask | candidate_mask;
+    while (events && !st->stopped) {
+        unsigned bit = __builtin_ctz(events);
+        uint32_t bit_mask = 1u << bit;
+        if (candidate_mask & bit_mask) {
+            st->line_is_candidate = true;
+        } else {
+            if (st->line_is_candidate)
+                ksEmitLine(st, base + bit);
+            st->line_number++;
+            st->line_start = base + bit + 1;
+            st->line_is_candidate = false;
+        }
+        events &= events - 1;
+    }
+}
+
+static void ksKernelScalarRange(const KS_Prefilter* pf, KS_ScanState* st, size_t begin, size_t length) {
+    for (size_t i = begin; i < length && !st->stopped; i++) {
+        unsigned char ch = (unsigned char)st->buffer[i];
+        if (ch == '\n') {
+            if (st->line_is_candidate)
+                ksEmitLine(st, i);
+            st->line_number++;
+            st->line_start = i + 1;
+            st->line_is_candidate = false;
+        } else if (pf->every_line || pf->is_first_byte[ch]) {
+            st->line_is_candidate = true;
+        }
+    }
+}
+
+static void ksKernelScalar(const KS_Prefilter* pf, KS_ScanState* st, size_t length) {
+    ksKernelScalarRange(pf, st, 0, length);
+}
+
+#if KS_X86_KERNELS
+
+__attribute__((target("sse2"))) static void ksKernelSSE2(const KS_Prefilter* pf, KS_ScanState* st, size_t length) {
+    const __m128i newline = _mm_set1_epi8('\n');
+    __m128i first_bytes[KS_MAX_FIRST_BYTES];
+    for (size_t k = 0; k < pf->first_bytes_count; k++)
+        first_bytes[k] = _mm_set1_epi8((char)pf->first_bytes[k]);
+
+    size_t i = 0;
+    for (; i + 16 <= length && !st->stopped; i += 16) {
+        __m128i chunk = _mm_loadu_si128((const __m128i*)(st->buffer + i));
+        uint32_t newline_mask = (uint32_t)_mm_movemask_epi8(_mm_cmpeq_epi8(chunk, newline));
+        uint32_t candidate_mask;
+        if (pf->every_line) {
+            candidate_mask = ~newline_mask & 0xffffu;
+        } else {
+            __m128i hits = _mm_setzero_si128();
+            for (size_t k = 0; k < pf->first_bytes_count; k++)
+                hits = _mm_or_si128(hits, _mm_cmpeq_epi8(chunk, first_bytes[k]));
+            candidate_mask = (uint32_t)_mm_movemask_epi8(hits);
+        }
+        ksProcessBlock(st, i, newline_mask, candidate_mask);
+    }
+    ksKernelScalarRange(pf, st, i, length);
+}
+
+__attribute__((target("avx2"))) static void ksKernelAVX2(const KS_Prefilter* pf, KS_ScanState* st, size_t length) {
+    const __m256i newline = _mm256_set1_epi8('\n');
+    __m256i first_bytes[KS_MAX_FIRST_BYTES];
+    for (size_t k = 0; k < pf->first_bytes_count; k++)
+        first_bytes[k] = _mm256_set1_epi8((char)pf->first_bytes[k]);
+
+    size_t i = 0;
+    for (; i + 32 <= length && !st->stopped; i += 32) {
+        __m256i chunk = _mm256_loadu_si256((const __m256i*)(st->buffer + i));
+        uint32_t newline_mask = (uint32_t)_mm256_movemask_epi8(_mm256_cmpeq_epi8(chunk, newline));
+        uint32_t candidate_mask;
+        if (pf->every_line) {
+            candidate_mask = ~newline_mask;
+        } else {
+            __m256i hits = _mm256_setzero_si256();
+            for (size_t k = 0; k < pf->first_bytes_count; k++)
+                hits = _mm256_or_si256(hits, _mm256_cmpeq_epi8(chunk, first_bytes[k]));
+            candidate_mask = (uint32_t)_mm256_movemask_epi8(hits);
+        }
+        ksProcessBlock(st, i, newline_mask, candidate_mask);
+    }
+    ksKernelScalarRange(pf, st, i, length);
+}
+
+#endif
+
+void ksPrefilterInit(KS_Prefilter* pf) {
+    memset(pf, 0, sizeof(*pf));
+}
+
+void ksPrefilterAddKeyword(KS_Prefilter* pf, const char* keyword) {
+    if (!keyword || *keyword == '\0')
+        return;
+    unsigned char first = (unsigned char)keyword[0];
+    if (first == '\n') { // can never be told apart from a line break
+        pf->every_line = true;
+        return;
+    }
+    if (pf->is_first_byte[first])
+        return;
+    pf->is_first_byte[first] = true;
+    if (pf->first_bytes_count < KS_MAX_FIRST_BYTES)
+        pf->first_bytes[pf->first_bytes_count++] = first;
+    else
+        pf->every_line = true;
+}
+
+// Pick the widest kernel the running CPU supports.
+void ksPrefilterCompile(KS_Prefilter* pf) {
+    pf->kernel = ksKernelScalar;
+    pf->kernel_name = "scalar";
+#if KS_X86_KERNELS
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) {
+        pf->kernel = ksKernelAVX2;
+        pf->kernel_name = "avx2";
+    } else if (__builtin_cpu_supports("sse2")) {
+        pf->kernel = ksKernelSSE2;
+        pf->kernel_name = "sse2";
+    }
+#endif
+}
+
+// Split buffer into lines and hand the candidate ones to on_candidate.
+// Returns the number of lines seen.
+size_t ksScanLines(const KS_Prefilter* pf, const char* buffer, size_t length, KS_LineCallback on_candidate, void* user) {
+    KS_ScanState st;
+    memset(&st, 0, sizeof(st));
+    st.buffer = buffer;
+    st.line_number = 1;
+    st.on_candidate = on_candidate;
+    st.user = user;
+
+    if (pf->first_bytes_count == 0 && !pf->every_line) { // no keywords, nothing can match
+        for (const char* ch = buffer; (ch = memchr(ch, '\n', buffer + length - ch)); ch++)
+            st.line_number++;
+    } else {
+        (pf->kernel ? pf->kernel : ksKernelScalar)(pf, &st, length);
+        if (!st.stopped && st.line_is_candidate && st.line_start < length)
+            ksEmitLine(&st, length); // last line without a trailing '\n'
+    }
+
+    if (length == 0 || buffer[length - 1] == '\n')
+        return st.line_number - 1;
+    return st.line_number;
+}
+
+const char* ksKernelName(const KS_Prefilter* pf) {
+    return pf->kernel_name ? pf->kernel_name : "scalar";
+}
+
+// Drop leading blanks and an org heading or list item marker ("** ", "- ",
+// "+ ", "# ") from text_line, in place.
+void ksTrimItemPrefix(char* text_line) {
+    if (!text_line)
+        return;
+
+    char* char_ptr = text_line;
+
+    // Skip leading whitespace first
+    while (*char_ptr == ' ' || *char_ptr == '\t') {
+        char_ptr++;
+    }
+
+    if (*char_ptr == '*') { // * Org headings
+        while (*char_ptr == '*') {
+            char_ptr++;
+        }
+        if (*char_ptr == ' ') {
+            char_ptr++; // Skip the space if it is there
+        }
+    } else if (*char_ptr == '-') { // - Items
+        while (*char_ptr == '-') {
+            char_ptr++;
+        }
+        if (*char_ptr == ' ') {
+            char_ptr++;
+        }
+    } else if (*char_ptr == '+') { // + Items
+        while (*char_ptr == '+') {
+            char_ptr++;
+        }
+        if (*char_ptr == ' ') {
+            char_ptr++;
+        }
+    } else if (*char_ptr == '#') { // # Items
+        while (*char_ptr == '#') {
+            char_ptr++;
+        }
+        if (*char_ptr == ' ') {
+            char_ptr++;
+        }
+    }
+
+    memmove(text_line, char_ptr, strlen(char_ptr) + 1);
+}
+
+// ksTrimItemPrefix(), then drop keyword (and one space after it) if the line
+// starts with it.
+void ksTrimKeywordPrefix(char* text_line, const char* keyword) {
+    if (!text_line || !keyword || strcmp(keyword, "") == 0)
+        return;
+
+    char* char_ptr = text_line;
+
+    ksTrimItemPrefix(char_ptr);
+
+    size_t compare_length = strlen(keyword);
+    if (strncmp(char_ptr, keyword, compare_length) == 0) {
+        char_ptr += compare_length;
+        if (*char_ptr == ' ') {
+            char_ptr++; // Skip only if there is a space key here
+        }
+    }
+
+    memmove(text_line, char_ptr, strlen(char_ptr) + 1);
+}
+
+#endif // KS_H_
@@ -1,4 +1,13 @@
+#include "ac.h"
+#include "ar.h"
+#include "cf.h"
 #include "ff.h"
+#include "fw.h"
+#include "ks.h"
+#include "mt.h"
+#include "sc.h"
+#include "si.h"
+#include "tr.h"
 #if defined(__APPLE__)
 #include <SDL.h>
 #include <SDL_events.h>
@@ -26,6 +35,8 @@
 #include <SDL2/SDL_ttf.h>
 #include <SDL2/SDL_video.h>
 #endif
+#include <ctype.h>
+#include <errno.h>
 #include <stdbool.h>
 #include <stdio.h>
 #include <stdlib.h>
@@ -42,18 +53,30 @@
 
 // tweakables
 #define MAX_TARGET_PATHS 90
-#define MAX_KEYWORDS 10
-#define MAX_LINES_IN_CONFIG_FILE 100
-#define MAX_MATCHING_LINES_CAPACITY 150
+#define MAX_KEYWORDS 64
 #define MAX_STRING_LENGTH_CAPACITY 512
 #define COLOR_CHANGE_FACTOR 16
-#define SDL_DELAY_FACTOR 256
+#define STAT_POLL_INTERVAL_MS 256
+#define MAX_SCAN_WORKERS 16
+#define MAX_DIAGNOSTICS 16
+#define DIAGNOSTICS_LOG_INTERVAL_MS 10000
+#define FONT_DISCOVERY_EVENT_INTERVAL_MS 50
+#define FONT_PICKER_WHEEL_ROWS 3
+#define FONT_INDEX_CHUNK_SIZE 256
+#define DEFAULT_TEXTURE_CACHE_BUDGET_MB 16
+#define PERF_HUD_REFRESH_MS 1000
+#define PERF_HUD_SCALE 0.5f
+#define METRICS_FILE_INTERVAL_MS 10000
 #define ZOOM_SCALE_FACTOR 0.15f
 #define MIN_ZOOM_SCALE 0.5f
 #define MAX_ZOOM_SCALE 5.0f
 #define DEMO_TARGET_FILE "todos.org"
 #define DEMO_EXAMPLE_KEYWORD "TODO"
 #define CONFIG_FILE_NAME ".currTasks.conf"
+#define FONT_CACHE_FILE_NAME "froomf-fonts.cache"
+#define PRESENT_LOG_ENV_VAR "FROOMF_PRESENT_LOG"
+#define TRACE_ENV_VAR "FROOMF_TRACE"
+#define METRICS_ENV_VAR "FROOMF_METRICS"
 
 #ifdef DEBUG_MODE
     #define DEBUG_SHOW_LOC(fmt, ...) fprintf(stdout, "\n%s:%d:" CYN " %s():\n" RESET fmt, __FILE__, __LINE__, __func__, ##__VA_ARGS__)
@@ -87,94 +110,532 @@ bool file_exists(const char* filename) {
     return false;
 }
 
-void keyword_lines_into_array(const char* file_path, char** destination_array, size_t* destination_array_index, size_t destination_array_max_capacity, char** keywords_source_array, size_t keywords_source_count) {
-    if (!file_exists(file_path)) {
-        DEBUG_SHOW_LOC("SKIPPING file %s since it doesn't exist.\n", file_path);
+// Problems shown in the overlay's status line instead of in modal message
+// boxes. Each one has a key (e.g. "missing:<path>") and is only reported when
+// its state changes, and a key that keeps flapping is logged at most once per
+// DIAGNOSTICS_LOG_INTERVAL_MS. Safe to use from any thread.
+typedef struct {
+    char key[MAX_STRING_LENGTH_CAPACITY];
+    char message[MAX_STRING_LENGTH_CAPACITY];
+    bool active;
+    bool logged;
+    Uint32 logged_ticks;
+} Diagnostic;
 
-        char message[MAX_STRING_LENGTH_CAPACITY];
-        snprintf(message, MAX_STRING_LENGTH_CAPACITY, "Skipping file %s since it doesn't exist.", file_path);
-        SDL_ShowSimpleMessageBox(SDL_MESSAGEBOX_ERROR, "Error", message, NULL);
-        return;
+typedef struct {
+    SDL_mutex* mutex;
+    Diagnostic entries[MAX_DIAGNOSTICS];
+    size_t count;
+    size_t dropped_count; // reports that didn't fit
+    Uint32 version;       // bumped on every state change
+} Diagnostics;
+
+void diagnostics_init(Diagnostics* diagnostics) {
+    memset(diagnostics, 0, sizeof(*diagnostics));
+    diagnostics->mutex = check_ptr(SDL_CreateMutex(), "Couldn't create a SDL mutex", SDL_GetError());
+}
+
+void diagnostics_destroy(Diagnostics* diagnostics) {
+    SDL_DestroyMutex(diagnostics->mutex);
+    memset(diagnostics, 0, sizeof(*diagnostics));
+}
+
+Diagnostic* diagnostics_find_locked(Diagnostics* diagnostics, const char* key) {
+    for (size_t i = 0; i < diagnostics->count; i++) {
+        if (strcmp(diagnostics->entries[i].key, key) == 0) {
+            return &diagnostics->entries[i];
+        }
+    }
+    return NULL;
+}
+
+void diagnostics_report(Diagnostics* diagnostics, const char* key, const char* message) {
+    SDL_LockMutex(diagnostics->mutex);
+    Diagnostic* diagnostic = diagnostics_find_locked(diagnostics, key);
+    if (!diagnostic) {
+        if (diagnostics->count == MAX_DIAGNOSTICS) { // reuse a resolved slot, or give up
+            for (size_t i = 0; i < diagnostics->count && !diagnostic; i++) {
+                if (!diagnostics->entries[i].active) {
+                    diagnostic = &diagnostics->entries[i];
+                }
+            }
+            if (!diagnostic) {
+                diagnostics->dropped_count++;
+                SDL_UnlockMutex(diagnostics->mutex);
+                return;
+            }
+        } else {
+            diagnostic = &diagnostics->entries[diagnostics->count++];
+        }
+        memset(diagnostic, 0, sizeof(*diagnostic));
+        snprintf(diagnostic->key, MAX_STRING_LENGTH_CAPACITY, "%s", key);
+    }
+
+    if (!diagnostic->active || strcmp(diagnostic->message, message) != 0) {
+        diagnostic->active = true;
+        snprintf(diagnostic->message, MAX_STRING_LENGTH_CAPACITY, "%s", message);
+        diagnostics->version++;
+
+        Uint32 now = SDL_GetTicks();
+        if (!diagnostic->logged || now - diagnostic->logged_ticks >= DIAGNOSTICS_LOG_INTERVAL_MS) {
+            diagnostic->logged = true;
+            diagnostic->logged_ticks = now;
+            fprintf(stderr, "%s\n", message);
+        }
+    }
+    SDL_UnlockMutex(diagnostics->mutex);
+}
+
+// Resolve every diagnostic whose key starts with key_prefix, except the ones
+// in keep_keys.
+void diagnostics_resolve_except(Diagnostics* diagnostics, const char* key_prefix, char (*keep_keys)[MAX_STRING_LENGTH_CAPACITY], size_t keep_count) {
+    size_t key_prefix_length = strlen(key_prefix);
+    SDL_LockMutex(diagnostics->mutex);
+    for (size_t i = 0; i < diagnostics->count; i++) {
+        Diagnostic* diagnostic = &diagnostics->entries[i];
+        if (!diagnostic->active || strncmp(diagnostic->key, key_prefix, key_prefix_length) != 0) {
+            continue;
+        }
+        bool kept = false;
+        for (size_t j = 0; j < keep_count && !kept; j++) {
+            kept = strcmp(diagnostic->key, keep_keys[j]) == 0;
+        }
+        if (!kept) {
+            diagnostic->active = false;
+            diagnostics->version++;
+        }
     }
-    void* file_content = check_ptr(SDL_LoadFile(file_path, NULL), "Couldn't find target file..", SDL_GetError());
-    char* file_content_line = strtok((char*)file_content, "\n");
-
-    // Search for the keywords in each line
-    DEBUG_SHOW_LOC("Matching lines:\n");
-    while (file_content_line != NULL && *destination_array_index < destination_array_max_capacity) {
-        for (size_t i = 0; i < keywords_source_count; i++) {
-            if (strstr(file_content_line, keywords_source_array[i])) {
-                snprintf(destination_array[*destination_array_index], MAX_STRING_LENGTH_CAPACITY, "%s", file_content_line);
-                (*destination_array_index)++;
-                DEBUG_PRINTF("%s\n", file_content_line);
+    SDL_UnlockMutex(diagnostics->mutex);
+}
+
+// Resolve every diagnostic whose key starts with key_prefix.
+void diagnostics_resolve(Diagnostics* diagnostics, const char* key_prefix) {
+    diagnostics_resolve_except(diagnostics, key_prefix, NULL, 0);
+}
+
+// Resolve the diagnostic with exactly this key, if it is active.
+void diagnostics_resolve_key(Diagnostics* diagnostics, const char* key) {
+    SDL_LockMutex(diagnostics->mutex);
+    Diagnostic* diagnostic = diagnostics_find_locked(diagnostics, key);
+    if (diagnostic && diagnostic->active) {
+        diagnostic->active = false;
+        diagnostics->version++;
+    }
+    SDL_UnlockMutex(diagnostics->mutex);
+}
+
+// Write a one line summary of the active diagnostics into status_line.
+// Returns false when there is nothing to show.
+bool diagnostics_status_line(Diagnostics* diagnostics, char* status_line, size_t status_line_capacity) {
+    SDL_LockMutex(diagnostics->mutex);
+    const char* first_message = NULL;
+    size_t active_count = 0;
+    for (size_t i = 0; i < diagnostics->count; i++) {
+        if (diagnostics->entries[i].active) {
+            if (!first_message) {
+                first_message = diagnostics->entries[i].message;
             }
+            active_count++;
+        }
+    }
+    if (first_message) {
+        if (active_count > 1) {
+            snprintf(status_line, status_line_capacity, "! %s (+%zu more)", first_message, active_count - 1);
+        } else {
+            snprintf(status_line, status_line_capacity, "! %s", first_message);
+        }
+    }
+    SDL_UnlockMutex(diagnostics->mutex);
+    return first_message != NULL;
+}
+
+// A target file's latest matches, kept until the file's size or mtime changes
+// (or the watcher reports it as changed).
+typedef struct {
+    char path[MAX_STRING_LENGTH_CAPACITY];
+    bool valid;
+    bool exists;
+    off_t size;
+    time_t mtime;
+    bool queued; // picked for the current scan batch
+    bool load_failed;
+    bool interrupted;        // the scan was cancelled before the file was done
+    SC_FileMatches* matches; // NULL until the file is scanned
+} FileScanResult;
+
+typedef struct {
+    FileScanResult* files;
+    size_t size;
+    size_t capacity;
+    bool use_mmap; // map target files read-only instead of copying them
+} ScanCache;
+
+void file_scan_result_clear(FileScanResult* result) {
+    scFileMatchesRelease(result->matches);
+    result->matches = NULL;
+}
+
+typedef void (*WorkerJob)(void* job_data, size_t job_index);
+
+// Fixed set of threads that run the jobs of one batch at a time. The thread
+// that submits a batch works on it too, so a pool without threads just runs
+// the batch inline. Batches submitted from several threads run one after the
+// other.
+typedef struct {
+    SDL_Thread* threads[MAX_SCAN_WORKERS];
+    size_t thread_count;
+    SDL_mutex* batch_mutex; // held by the thread whose batch is running
+    SDL_mutex* mutex;
+    SDL_cond* work_available;
+    SDL_cond* work_finished;
+    WorkerJob job;
+    void* job_data;
+    size_t job_count;
+    size_t next_job_index;
+    size_t unfinished_job_count;
+    bool should_stop;
+} WorkerPool;
+
+int worker_pool_thread(void* args) {
+    WorkerPool* pool = (WorkerPool*)args;
+    trSetThreadName("worker");
+
+    SDL_LockMutex(pool->mutex);
+    while (true) {
+        while (!pool->should_stop && pool->next_job_index >= pool->job_count) {
+            SDL_CondWait(pool->work_available, pool->mutex);
+        }
+        if (pool->should_stop) {
+            break;
+        }
+        size_t job_index = pool->next_job_index++;
+        WorkerJob job = pool->job;
+        void* job_data = pool->job_data;
+        SDL_UnlockMutex(pool->mutex);
+
+        job(job_data, job_index);
+
+        SDL_LockMutex(pool->mutex);
+        if (--pool->unfinished_job_count == 0) {
+            SDL_CondSignal(pool->work_finished);
         }
-        file_content_line = strtok(NULL, "\n");
     }
-    SDL_free(file_content);
+    SDL_UnlockMutex(pool->mutex);
+    trThreadExit();
+    return 0;
 }
 
-void trim_leading_item_prefix(char* text_line) {
-    if (!text_line)
+// One worker per CPU besides the calling thread, up to MAX_SCAN_WORKERS.
+void worker_pool_init(WorkerPool* pool) {
+    memset(pool, 0, sizeof(*pool));
+    pool->batch_mutex = check_ptr(SDL_CreateMutex(), "Couldn't create a SDL mutex", SDL_GetError());
+    pool->mutex = check_ptr(SDL_CreateMutex(), "Couldn't create a SDL mutex", SDL_GetError());
+    pool->work_available = check_ptr(SDL_CreateCond(), "Couldn't create a SDL condition variable", SDL_GetError());
+    pool->work_finished = check_ptr(SDL_CreateCond(), "Couldn't create a SDL condition variable", SDL_GetError());
+
+    int cpu_count = SDL_GetCPUCount();
+    size_t thread_count = cpu_count > 1 ? (size_t)cpu_count - 1 : 0;
+    if (thread_count > MAX_SCAN_WORKERS) {
+        thread_count = MAX_SCAN_WORKERS;
+    }
+    for (size_t i = 0; i < thread_count; i++) {
+        pool->threads[i] = SDL_CreateThread(worker_pool_thread, "scan_worker", pool);
+        if (!pool->threads[i]) { // make do with the threads we have
+            DEBUG_SHOW_LOC("Couldn't create scan worker %zu: %s\n", i, SDL_GetError());
+            break;
+        }
+        pool->thread_count++;
+    }
+    DEBUG_SHOW_LOC("Started %zu worker threads\n", pool->thread_count);
+}
+
+// Run job(job_data, i) for every i below job_count, and wait for all of them.
+void worker_pool_run(WorkerPool* pool, WorkerJob job, void* job_data, size_t job_count) {
+    if (job_count == 0) {
         return;
+    }
 
-    char* char_ptr = text_line;
+    SDL_LockMutex(pool->batch_mutex);
+    SDL_LockMutex(pool->mutex);
+    pool->job = job;
+    pool->job_data = job_data;
+    pool->job_count = job_count;
+    pool->next_job_index = 0;
+    pool->unfinished_job_count = job_count;
+    SDL_CondBroadcast(pool->work_available);
+
+    while (pool->next_job_index < pool->job_count) {
+        size_t job_index = pool->next_job_index++;
+        SDL_UnlockMutex(pool->mutex);
+        job(job_data, job_index);
+        SDL_LockMutex(pool->mutex);
+        pool->unfinished_job_count--;
+    }
+    while (pool->unfinished_job_count > 0) {
+        SDL_CondWait(pool->work_finished, pool->mutex);
+    }
+    pool->job_count = 0;
+    pool->next_job_index = 0;
+    SDL_UnlockMutex(pool->mutex);
+    SDL_UnlockMutex(pool->batch_mutex);
+}
 
-    // Skip leading whitespace first
-    while (*char_ptr == ' ' || *char_ptr == '\t') {
-        char_ptr++;
+void worker_pool_destroy(WorkerPool* pool) {
+    SDL_LockMutex(pool->mutex);
+    pool->should_stop = true;
+    SDL_CondBroadcast(pool->work_available);
+    SDL_UnlockMutex(pool->mutex);
+    for (size_t i = 0; i < pool->thread_count; i++) {
+        SDL_WaitThread(pool->threads[i], NULL);
     }
+    SDL_DestroyCond(pool->work_finished);
+    SDL_DestroyCond(pool->work_available);
+    SDL_DestroyMutex(pool->mutex);
+    SDL_DestroyMutex(pool->batch_mutex);
+    memset(pool, 0, sizeof(*pool));
+}
+
+// Runs on scan worker threads, so failures are only recorded in the result
+// and reported by the caller. The result gets new SC_FileMatches, the ones it
+// had stay intact for the snapshots that still show them.
+void keyword_lines_into_array(const char* file_path, FileScanResult* result, size_t file_id, const SC_KeywordMatcher* keyword_matcher, bool use_mmap, const SC_Cancellation* cancellation) {
+    file_scan_result_clear(result);
+    result->matches = scFileMatchesCreate();
+    SC_ScanStatus status = scScanFile(file_path, file_id, keyword_matcher, use_mmap, cancellation, result->matches);
+    result->interrupted = status == SC_SCAN_INTERRUPTED;
+    result->load_failed = status == SC_SCAN_LOAD_FAILED;
+    DEBUG_PRINTF("%s: %zu matching lines (%s)\n", file_path, result->matches->matches.span_count, result->matches->file_data.mapped ? "mmap" : "read");
+}
 
-    if (*char_ptr == '*') { // * Org headings
-        while (*char_ptr == '*') {
-            char_ptr++;
+FileScanResult* scan_cache_lookup(ScanCache* cache, const char* file_path) {
+    for (size_t i = 0; i < cache->size; i++) {
+        if (strcmp(cache->files[i].path, file_path) == 0) {
+            return &cache->files[i];
         }
-        if (*char_ptr == ' ') {
-            char_ptr++; // Skip the space if it is there
+    }
+    if (cache->capacity < cache->size + 1) {
+        size_t new_capacity = cache->capacity ? cache->capacity * 2 : 8;
+        cache->files = check_ptr(realloc(cache->files, new_capacity * sizeof(FileScanResult)), "Couldn't grow the scan cache", "out of memory");
+        cache->capacity = new_capacity;
+    }
+    FileScanResult* result = &cache->files[cache->size++];
+    memset(result, 0, sizeof(*result));
+    snprintf(result->path, MAX_STRING_LENGTH_CAPACITY, "%s", file_path);
+    return result;
+}
+
+typedef struct {
+    ScanCache* cache;
+    FileScanResult** results;
+    const SC_KeywordMatcher* keyword_matcher;
+    const SC_Cancellation* cancellation;
+} ScanBatch;
+
+void scan_batch_job(void* job_data, size_t job_index) {
+    ScanBatch* batch = (ScanBatch*)job_data;
+    FileScanResult* result = batch->results[job_index];
+    uint64_t traced = trBegin();
+    keyword_lines_into_array(result->path, result, result - batch->cache->files, batch->keyword_matcher, batch->cache->use_mmap, batch->cancellation);
+    trEnd("keyword_lines_into_array", traced, result->path);
+}
+
+// Parse the target files again, spread over the worker pool. With changed set
+// only the targets flagged in it are parsed, unconditionally (the watcher
+// reported them, and st_mtime only has second resolution). Without it every
+// target is checked and parsed unless its cached result still matches the
+// file's size and mtime. Targets left half parsed by a cancelled scan are
+// always parsed again. Missing files are reported to diagnostics. Returns the
+// number of targets that were picked to be parsed again. Of those, the ones
+// that were read and parsed in full are counted in *files_parsed, and the
+// bytes read from them in *bytes_parsed.
+size_t scan_cache_refresh_targets(ScanCache* cache, char** target_paths_array, size_t target_paths_count, const bool* changed, const SC_KeywordMatcher* keyword_matcher, WorkerPool* pool, const SC_Cancellation* cancellation,
+                                  Diagnostics* diagnostics, size_t* files_parsed, Uint64* bytes_parsed) {
+    // create every entry first, the workers need stable pointers into cache->files
+    for (size_t i = 0; i < target_paths_count; i++) {
+        scan_cache_lookup(cache, target_paths_array[i]);
+    }
+
+    FileScanResult* results[MAX_TARGET_PATHS];
+    size_t result_count = 0;
+    for (size_t i = 0; i < target_paths_count; i++) {
+        FileScanResult* result = scan_cache_lookup(cache, target_paths_array[i]);
+        if (changed && !changed[i] && result->valid) {
+            continue;
         }
-    } else if (*char_ptr == '-') { // - Items
-        while (*char_ptr == '-') {
-            char_ptr++;
+
+        struct stat file_stat;
+        bool exists = stat(result->path, &file_stat) == 0;
+        off_t size = exists ? file_stat.st_size : 0;
+        time_t mtime = exists ? file_stat.st_mtime : 0;
+
+        if (result->queued || (!changed && result->valid && result->exists == exists && result->size == size && result->mtime == mtime)) {
+            DEBUG_PRINTF("%s: cached, %zu matching lines\n", result->path, result->matches ? result->matches->matches.span_count : 0);
+            continue;
         }
-        if (*char_ptr == ' ') {
-            char_ptr++;
+        result->queued = true;
+        result->exists = exists;
+        result->size = size;
+        result->mtime = mtime;
+        results[result_count++] = result;
+    }
+
+    ScanBatch batch = {cache, results, keyword_matcher, cancellation};
+    worker_pool_run(pool, scan_batch_job, &batch, result_count);
+
+    *files_parsed = 0;
+    *bytes_parsed = 0;
+    for (size_t i = 0; i < result_count; i++) {
+        results[i]->queued = false;
+        results[i]->valid = !results[i]->interrupted;
+        if (!results[i]->valid) {
+            continue;
         }
-    } else if (*char_ptr == '+') { // + Items
-        while (*char_ptr == '+') {
-            char_ptr++;
+        if (!results[i]->load_failed) {
+            (*files_parsed)++;
+            *bytes_parsed += (Uint64)results[i]->matches->bytes_read;
         }
-        if (*char_ptr == ' ') {
-            char_ptr++;
+
+        char diagnostic_key[MAX_STRING_LENGTH_CAPACITY];
+        snprintf(diagnostic_key, MAX_STRING_LENGTH_CAPACITY, "missing:%s", results[i]->path);
+        if (results[i]->load_failed) {
+            // the stat() from when the file was queued tells a missing file from an unreadable one
+            char message[MAX_STRING_LENGTH_CAPACITY];
+            if (results[i]->exists) {
+                snprintf(message, MAX_STRING_LENGTH_CAPACITY, "Skipping file %s since it couldn't be read: %s", results[i]->path, strerror(results[i]->matches->load_error));
+            } else {
+                snprintf(message, MAX_STRING_LENGTH_CAPACITY, "Skipping file %s since it doesn't exist.", results[i]->path);
+            }
+            DEBUG_SHOW_LOC("%s\n", message);
+            diagnostics_report(diagnostics, diagnostic_key, message);
+        } else {
+            diagnostics_resolve_key(diagnostics, diagnostic_key);
         }
-    } else if (*char_ptr == '#') { // # Items
-        while (*char_ptr == '#') {
-            char_ptr++;
+    }
+    return result_count;
+}
+
+// Drop the cached results of files that are no longer targets.
+void scan_cache_retain(ScanCache* cache, char** target_paths_array, size_t target_paths_count, Diagnostics* diagnostics) {
+    for (size_t i = 0; i < cache->size;) {
+        bool is_target = false;
+        for (size_t j = 0; j < target_paths_count && !is_target; j++) {
+            is_target = strcmp(cache->files[i].path, target_paths_array[j]) == 0;
         }
-        if (*char_ptr == ' ') {
-            char_ptr++;
+        if (is_target) {
+            i++;
+            continue;
         }
+
+        char diagnostic_key[MAX_STRING_LENGTH_CAPACITY];
+        snprintf(diagnostic_key, MAX_STRING_LENGTH_CAPACITY, "missing:%s", cache->files[i].path);
+        diagnostics_resolve_key(diagnostics, diagnostic_key);
+        file_scan_result_clear(&cache->files[i]);
+        cache->files[i] = cache->files[--cache->size];
+    }
+}
+
+// Drop every cached result, e.g. when the keywords change.
+void scan_cache_clear(ScanCache* cache) {
+    for (size_t i = 0; i < cache->size; i++) {
+        file_scan_result_clear(&cache->files[i]);
     }
+    cache->size = 0;
+}
 
-    memmove(text_line, char_ptr, strlen(char_ptr) + 1);
+void scan_cache_destroy(ScanCache* cache) {
+    scan_cache_clear(cache);
+    free(cache->files);
+    cache->files = NULL;
+    cache->capacity = 0;
 }
 
-void trim_keyword_prefix(char* text_line, char* keyword) {
-    if (!text_line || !keyword || strcmp(keyword, "") == 0)
-        return;
+// The entries shown by the UI: an index into the spans of the SC_FileMatches it
+// holds references to, and copies of the keywords its keyword ids refer to. It
+// stays valid while the scan thread rescans files or the config changes under
+// it.
+typedef struct {
+    AR_Arena arena; // entries and keywords, reset on every rebuild
+    const SC_MatchSpan** entries;
+    size_t entry_count;
+    SC_FileMatches* file_matches[MAX_TARGET_PATHS]; // referenced
+    size_t file_matches_count;
+    char** keywords; // indexed by SC_MatchSpan.keyword_id
+    size_t keywords_count;
+    bool complete; // false until a scan has finished into it
+
+    // the scan that produced it, for the performance HUD
+    double scan_ms;
+    Uint64 bytes_parsed;
+    size_t files_parsed;
+    size_t file_count;
+} EntrySnapshot;
+
+void entry_snapshot_init(EntrySnapshot* snapshot) {
+    memset(snapshot, 0, sizeof(*snapshot));
+    arInit(&snapshot->arena);
+}
 
-    char* char_ptr = text_line;
+void entry_snapshot_release_files(EntrySnapshot* snapshot) {
+    for (size_t i = 0; i < snapshot->file_matches_count; i++) {
+        scFileMatchesRelease(snapshot->file_matches[i]);
+    }
+    snapshot->file_matches_count = 0;
+}
+
+void entry_snapshot_destroy(EntrySnapshot* snapshot) {
+    entry_snapshot_release_files(snapshot);
+    arDestroy(&snapshot->arena);
+    memset(snapshot, 0, sizeof(*snapshot));
+}
 
-    trim_leading_item_prefix(char_ptr);
+// Rebuild the flat list of entries from the cached per-file results, in config
+// order (file order decides which entry is on top). Only the index is built,
+// the spans stay in the files' SC_FileMatches.
+size_t merge_scan_results_into_snapshot(ScanCache* cache, char** target_paths_array, size_t target_paths_count, char** keywords_array, size_t keywords_count, EntrySnapshot* destination) {
+    entry_snapshot_release_files(destination);
+    arReset(&destination->arena);
 
-    size_t compare_length = strlen(keyword);
-    if (strncmp(char_ptr, keyword, compare_length) == 0) {
-        char_ptr += compare_length;
-        if (*char_ptr == ' ') {
-            char_ptr++; // Skip only if there is a space key here
+    for (size_t i = 0; i < target_paths_count; i++) {
+        SC_FileMatches* file_matches = scan_cache_lookup(cache, target_paths_array[i])->matches;
+        if (file_matches) {
+            scFileMatchesRetain(file_matches);
+            destination->file_matches[destination->file_matches_count++] = file_matches;
         }
     }
+    destination->entries = scIndexMatches(&destination->arena, destination->file_matches, destination->file_matches_count, &destination->entry_count);
 
-    memmove(text_line, char_ptr, strlen(char_ptr) + 1);
+    destination->keywords = arAlloc(&destination->arena, (keywords_count ? keywords_count : 1) * sizeof(char*), alignof(char*));
+    for (size_t i = 0; i < keywords_count; i++) {
+        destination->keywords[i] = arStrndup(&destination->arena, keywords_array[i], strlen(keywords_array[i]));
+    }
+    destination->keywords_count = keywords_count;
+    destination->complete = true;
+    return destination->entry_count;
+}
+
+// Build the text shown for an entry: an optional prefix followed by its line
+// (optionally with item and keyword prefixes trimmed). Only called for entries
+// that get drawn. The text lives in *text_buffer until the next call.
+const char* entry_display_text(const SC_MatchSpan* span, const char* prefix, const char* keyword_to_trim, char** text_buffer, size_t* text_buffer_capacity) {
+    size_t prefix_length = strlen(prefix);
+    size_t needed = prefix_length + span->length + 1;
+    if (*text_buffer_capacity < needed) {
+        *text_buffer = check_ptr(realloc(*text_buffer, needed), "Couldn't grow the entry text buffer", "out of memory");
+        *text_buffer_capacity = needed;
+    }
+
+    char* line = *text_buffer + prefix_length;
+    memcpy(*text_buffer, prefix, prefix_length);
+    memcpy(line, span->text, span->length);
+    line[span->length] = '\0';
+    if (keyword_to_trim) {
+        ksTrimKeywordPrefix(line, keyword_to_trim);
+    }
+
+    if ((*text_buffer)[0] == '\0') { // SDL_ttf can't render empty strings
+        return " ";
+    }
+    return *text_buffer;
 }
 
 void send_ok_cancel_message_box(const char* title, const char* message, const char* message_on_failure) {
@@ -254,291 +715,1633 @@ FILE* create_demo_conf_file(const char* conf_file_path) {
     return fopen(conf_file_path, "r");
 }
 
-int conf_file_lines_into_array(const char* file_path, char** file_lines_array, const char* conf_file_filename) {
+// Parse the config file into config in one pass, creating a demo config first if there is none.
+// Syntax errors don't stop the parse, the lines are skipped and reported by report_config_errors().
+void load_config_file(const char* file_path, CF_Config* config, const char* conf_file_filename) {
 
-    FILE* file = fopen(file_path, "r");
-
-    if (!file) {
+    if (!file_exists(file_path)) {
         char message[MAX_STRING_LENGTH_CAPACITY];
         snprintf(message, MAX_STRING_LENGTH_CAPACITY, "Create a \"%s\" config file in $HOME?", conf_file_filename);
 
         DEBUG_SHOW_LOC("File '%s' not found. Trying to create a demo file.\n", file_path);
         // Get config file vars
         send_ok_cancel_message_box("Confirm", message, "Aborting since there is no config file.");
-        file = check_ptr(create_demo_conf_file(file_path), "Could not create the demo config file", SDL_GetError());
+        fclose(check_ptr(create_demo_conf_file(file_path), "Could not create the demo config file", SDL_GetError()));
     }
 
-    size_t curr_line = 0;
+    uint64_t traced = trBegin();
+    cfReset(config);
+    int loaded = cfLoadFile(config, file_path);
+    trEnd("load_config_file", traced, file_path);
+    if (loaded != 0) {
+        DEBUG_SHOW_LOC("Could not read config file '%s'\n", file_path);
+        return;
+    }
 
-    if (file) {
-        char string_buffer[MAX_STRING_LENGTH_CAPACITY];
+    DEBUG_SHOW_LOC("Read %zu lines, %zu keys from '%s'\n", config->line_count, config->entry_count, file_path);
+    for (size_t i = 0; i < config->entry_count; i++) {
+        for (size_t j = 0; j < config->entries[i].count; j++) {
+            DEBUG_PRINTF("%s: %s = \"%s\"\n", file_path, config->entries[i].key, config->entries[i].values[j]);
+        }
+    }
+}
 
-        // for every line from configuration file into buffer
-        while (fgets(string_buffer, sizeof(string_buffer), file)) {
+// Copy the values of key into destination_array, in file order. Returns how many were copied.
+size_t extract_config_values(const char* key, char** destination_array, size_t destination_array_length, const CF_Config* config) {
+    uint64_t traced = trBegin();
+    size_t count = scConfigValues(config, key, destination_array, destination_array_length, MAX_STRING_LENGTH_CAPACITY);
+    trEnd("extract_config_values", traced, key);
+    return count;
+}
 
-            // if length of buffer > 1 and buffer has a '\n', allocate a '\0' at the end
-            size_t string_buffer_len = strlen(string_buffer);
-            if (string_buffer_len > 0 && string_buffer[string_buffer_len - 1] == '\n') {
-                string_buffer[string_buffer_len - 1] = '\0';
-            }
+// Report key unless it already was during this pass, and remember it in
+// reported_keys. Once MAX_DIAGNOSTICS keys are in, the rest couldn't be kept
+// track of anyway, so they are left out.
+void report_config_error(Diagnostics* diagnostics, char (*reported_keys)[MAX_STRING_LENGTH_CAPACITY], size_t* reported_count, const char* key, const char* message) {
+    for (size_t i = 0; i < *reported_count; i++) {
+        if (strcmp(reported_keys[i], key) == 0) {
+            return;
+        }
+    }
+    if (*reported_count == MAX_DIAGNOSTICS) {
+        return;
+    }
+    snprintf(reported_keys[(*reported_count)++], MAX_STRING_LENGTH_CAPACITY, "%s", key);
+    diagnostics_report(diagnostics, key, message);
+}
 
-            snprintf(file_lines_array[curr_line], MAX_STRING_LENGTH_CAPACITY, "%s", string_buffer);
-            curr_line++;
+// Report the syntax errors and unknown keys of the last parse, and resolve the ones that got fixed.
+// Returns whether that changed the diagnostics shown. Errors that are still
+// there are reported again, which is a no-op unless their message changed, so
+// an unchanged config doesn't count as a change.
+bool report_config_errors(const CF_Config* config, const char* file_path, Diagnostics* diagnostics) {
+    char key[MAX_STRING_LENGTH_CAPACITY];
+    char message[MAX_STRING_LENGTH_CAPACITY];
+    char reported_keys[MAX_DIAGNOSTICS][MAX_STRING_LENGTH_CAPACITY];
+    size_t reported_count = 0;
+
+    SDL_LockMutex(diagnostics->mutex);
+    Uint32 version = diagnostics->version;
+    SDL_UnlockMutex(diagnostics->mutex);
+
+    size_t shown_error_count = config->error_count < CF_MAX_ERRORS ? config->error_count : CF_MAX_ERRORS;
+    for (size_t i = 0; i < shown_error_count; i++) {
+        snprintf(key, sizeof(key), "config:%zu", config->errors[i].line);
+        snprintf(message, sizeof(message), "%s:%zu: %s", file_path, config->errors[i].line, config->errors[i].message);
+        report_config_error(diagnostics, reported_keys, &reported_count, key, message);
+    }
+    if (config->error_count > shown_error_count) {
+        snprintf(message, sizeof(message), "%s: %zu more syntax errors", file_path, config->error_count - shown_error_count);
+        report_config_error(diagnostics, reported_keys, &reported_count, "config:more", message);
+    }
 
-            if (curr_line >= MAX_LINES_IN_CONFIG_FILE) {
-                DEBUG_SHOW_LOC("Warning: Reached maximum number of lines in config file: %d max lines allowed.\n", MAX_LINES_IN_CONFIG_FILE);
-                break;
-            }
+    for (size_t i = 0; i < config->entry_count; i++) {
+        bool known = false;
+        for (size_t j = 0; j < SC_CONFIG_KEY_COUNT && !known; j++) {
+            known = strcmp(config->entries[i].key, scConfigKeys[j]) == 0;
         }
+        if (!known) {
+            snprintf(key, sizeof(key), "config:%zu", config->entries[i].line);
+            snprintf(message, sizeof(message), "%s:%zu: unknown key '%s'", file_path, config->entries[i].line, config->entries[i].key);
+            report_config_error(diagnostics, reported_keys, &reported_count, key, message);
+        }
+    }
+    diagnostics_resolve_except(diagnostics, "config:", reported_keys, reported_count);
+
+    SDL_LockMutex(diagnostics->mutex);
+    bool changed = diagnostics->version != version;
+    SDL_UnlockMutex(diagnostics->mutex);
+    return changed;
+}
+
+// What a config reload changed, so it only costs what it has to: a rescan for
+// targets and keywords (only of the files it affects), a window update for
+// geometry and a redraw for presentation settings.
+typedef struct {
+    bool targets_changed;
+    bool keywords_changed;
+    bool mmap_targets_changed; // targets are read differently, rescan all of them
+    bool geometry_changed;
+    bool presentation_changed; // first_entry_only, trim_out_keywords
+    bool texture_cache_budget_changed;
+    bool renderer_changed;
+    bool font_family_changed;
+} ConfigDiff;
+
+ConfigDiff config_diff(const CF_Config* old_config, const CF_Config* new_config) {
+    ConfigDiff diff;
+    diff.targets_changed = !cfValuesEqual(old_config, new_config, "file");
+    diff.keywords_changed = !cfValuesEqual(old_config, new_config, "keyword");
+    diff.mmap_targets_changed = !cfValuesEqual(old_config, new_config, "mmap_targets");
+    diff.geometry_changed = !cfValuesEqual(old_config, new_config, "initial_window_width") || !cfValuesEqual(old_config, new_config, "initial_window_height") ||
+                            !cfValuesEqual(old_config, new_config, "initial_window_x") || !cfValuesEqual(old_config, new_config, "initial_window_y");
+    diff.presentation_changed = !cfValuesEqual(old_config, new_config, "first_entry_only") || !cfValuesEqual(old_config, new_config, "trim_out_keywords");
+    diff.texture_cache_budget_changed = !cfValuesEqual(old_config, new_config, "texture_cache_budget_mb");
+    diff.renderer_changed = !cfValuesEqual(old_config, new_config, "renderer");
+    diff.font_family_changed = !cfValuesEqual(old_config, new_config, "font_family");
+    return diff;
+}
+
+int parse_single_user_value_int(char** user_value_array, size_t user_value_count, int default_value) {
+    if (user_value_count < 1 || !isdigit(user_value_array[0][0])) {
+        return default_value;
+    }
+    return atoi(user_value_array[0]);
+}
+
+int parse_single_user_value_bool(char** user_value_array, size_t user_value_count, bool default_value) {
+    if (user_value_count < 1) {
+        return default_value;
+    }
+    if (strcmp(user_value_array[0], "true") == 0) {
+        return true;
+    }
+    return false;
+}
 
-        // Show the lines that are read
-        DEBUG_SHOW_LOC("Lines read from '%s':\n", file_path);
-        for (size_t i = 0; i < curr_line; i++) {
-            DEBUG_PRINTF("%s:%zu: line read: %s\n", file_path, i + 1, file_lines_array[i]);
+// With FROOMF_PRESENT_LOG set to a file (or a pipe, /dev/fd/N), every presented
+// frame appends "<CLOCK_MONOTONIC ns> <entry count>" to it, so that
+// bench/latency_bench.c can time an edit until the frame showing it.
+FILE* open_present_log(void) {
+#ifndef _WIN32
+    const char* present_log_path = getenv(PRESENT_LOG_ENV_VAR);
+    if (present_log_path && *present_log_path) {
+        FILE* present_log = fopen(present_log_path, "w");
+        if (!present_log) {
+            fprintf(stderr, "Couldn't open %s=%s\n", PRESENT_LOG_ENV_VAR, present_log_path);
         }
+        return present_log;
+    }
+#endif
+    return NULL;
+}
 
-        fclose(file);
+void log_present(FILE* present_log, size_t entry_count) {
+#ifndef _WIN32
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    fprintf(present_log, "%lld %zu\n", (long long)now.tv_sec * 1000000000ll + now.tv_nsec, entry_count);
+    fflush(present_log);
+#else
+    (void)present_log, (void)entry_count;
+#endif
+}
+
+// Counters for fleet monitoring, served by a MetricsServer. Every field is
+// updated with relaxed atomic adds, so the scan thread and the main loop never
+// wait on each other or on a scrape.
+typedef struct {
+    _Atomic uint64_t rescans; // finished, not cancelled
+    _Atomic uint64_t files_scanned;
+    _Atomic uint64_t bytes_read;
+    MT_Histogram scan_seconds;
+    _Atomic uint64_t frames;
+    MT_Histogram render_seconds;
+    _Atomic uint64_t texture_cache_bytes;
+} Metrics;
+
+void metrics_init(Metrics* metrics) {
+    static const double scan_bounds[] = {0.001, 0.0025, 0.005, 0.01, 0.025, 0.05, 0.1, 0.25, 0.5, 1, 2.5, 5};
+    static const double render_bounds[] = {0.0005, 0.001, 0.002, 0.004, 0.008, 0.016, 0.033, 0.066, 0.133, 0.25};
+    memset(metrics, 0, sizeof(*metrics));
+    mtHistogramInit(&metrics->scan_seconds, scan_bounds, SDL_arraysize(scan_bounds));
+    mtHistogramInit(&metrics->render_seconds, render_bounds, SDL_arraysize(render_bounds));
+}
+
+// 0 where it can't be read (only Linux has /proc/self/statm).
+Uint64 resident_memory_bytes(void) {
+#ifdef __linux__
+    FILE* statm = fopen("/proc/self/statm", "r");
+    unsigned long long total_pages, resident_pages;
+    int parsed = statm ? fscanf(statm, "%llu %llu", &total_pages, &resident_pages) : 0;
+    if (statm) {
+        fclose(statm);
+    }
+    if (parsed == 2) {
+        return (Uint64)resident_pages * (Uint64)sysconf(_SC_PAGESIZE);
+    }
+#endif
+    return 0;
+}
+
+void metrics_write(FILE* out, Metrics* metrics) {
+    mtWriteCounter(out, "froomf_rescans_total", "Scans of the target files that ran to completion.", atomic_load(&metrics->rescans));
+    mtWriteCounter(out, "froomf_files_scanned_total", "Target files parsed.", atomic_load(&metrics->files_scanned));
+    mtWriteCounter(out, "froomf_bytes_read_total", "Bytes of target files parsed.", atomic_load(&metrics->bytes_read));
+    mtWriteHistogram(out, "froomf_scan_duration_seconds", "Time from a scan request until its entries are ready.", &metrics->scan_seconds);
+    mtWriteCounter(out, "froomf_frames_total", "Frames rendered.", atomic_load(&metrics->frames));
+    mtWriteHistogram(out, "froomf_render_duration_seconds", "Time to render and present a frame.", &metrics->render_seconds);
+    mtWriteGauge(out, "froomf_texture_cache_bytes", "Memory held by cached text textures.", (double)atomic_load(&metrics->texture_cache_bytes));
+    Uint64 resident_bytes = resident_memory_bytes();
+    if (resident_bytes > 0) {
+        mtWriteGauge(out, "froomf_resident_memory_bytes", "Resident set size.", (double)resident_bytes);
     }
+}
 
-    // return the number of lines found
-    return curr_line;
+// With FROOMF_METRICS=socket the metrics are served in Prometheus text format
+// on $XDG_RUNTIME_DIR/froomf-<pid>.sock, to every client that connects. With
+// FROOMF_METRICS=file they are written to $XDG_RUNTIME_DIR/froomf-<pid>.prom
+// every METRICS_FILE_INTERVAL_MS instead (replaced by a rename, so readers
+// never see half of it). Either way the thread only wakes up for a client or
+// a write. Not available on Windows.
+typedef struct {
+    SDL_Thread* thread;
+    Metrics* metrics;
+    MT_Endpoint endpoint;
+    char file_path[MAX_STRING_LENGTH_CAPACITY]; // empty when serving on the socket
+    SDL_atomic_t should_run;
+} MetricsServer;
+
+#ifndef _WIN32
+void metrics_server_write_file(MetricsServer* server, const char* text, size_t length) {
+    char temp_path[MAX_STRING_LENGTH_CAPACITY + 8];
+    snprintf(temp_path, sizeof(temp_path), "%s.tmp", server->file_path);
+    FILE* file = fopen(temp_path, "wb");
+    bool written = file && fwrite(text, 1, length, file) == length;
+    if (file && fclose(file) != 0) {
+        written = false;
+    }
+    if (!written || rename(temp_path, server->file_path) != 0) {
+        DEBUG_SHOW_LOC("Couldn't write the metrics to %s\n", server->file_path);
+        remove(temp_path);
+    }
 }
 
-bool array_contains_string(char** array, size_t array_size, char* string) {
-    for (size_t i = 0; i < array_size; i++) {
-        if (strstr(array[i], string)) {
-            return true;
+int metrics_server_thread(void* args) {
+    MetricsServer* server = (MetricsServer*)args;
+    bool to_file = server->file_path[0] != '\0';
+
+    while (SDL_AtomicGet(&server->should_run)) {
+        int client_fd = to_file ? -1 : mtEndpointWait(&server->endpoint, -1);
+        if (to_file || client_fd >= 0) {
+            char* text = NULL;
+            size_t length = 0;
+            FILE* out = check_ptr(open_memstream(&text, &length), "Couldn't format the metrics", "out of memory");
+            metrics_write(out, server->metrics);
+            fclose(out);
+            if (to_file) {
+                metrics_server_write_file(server, text, length);
+            } else {
+                mtEndpointServe(client_fd, text, length);
+            }
+            free(text);
         }
+        if (to_file) {
+            mtEndpointWait(&server->endpoint, METRICS_FILE_INTERVAL_MS);
+        }
+    }
+    return 0;
+}
+#endif
+
+// Start serving metrics as FROOMF_METRICS asks. Returns false when it's unset
+// or the endpoint can't be set up (which is reported on stderr).
+bool metrics_server_start(MetricsServer* server, Metrics* metrics) {
+    const char* mode = getenv(METRICS_ENV_VAR);
+    if (!mode || !*mode) {
+        return false;
     }
+#ifndef _WIN32
+    bool to_file = strcmp(mode, "file") == 0;
+    if (!to_file && strcmp(mode, "socket") != 0) {
+        fprintf(stderr, "%s should be \"socket\" or \"file\", not \"%s\"\n", METRICS_ENV_VAR, mode);
+        return false;
+    }
+    const char* runtime_dir = getenv("XDG_RUNTIME_DIR");
+    if (!runtime_dir || !*runtime_dir) {
+        fprintf(stderr, "%s=%s needs $XDG_RUNTIME_DIR\n", METRICS_ENV_VAR, mode);
+        return false;
+    }
+
+    memset(server, 0, sizeof(*server));
+    server->metrics = metrics;
+    char socket_path[MAX_STRING_LENGTH_CAPACITY];
+    if (to_file) {
+        snprintf(server->file_path, sizeof(server->file_path), "%s/froomf-%d.prom", runtime_dir, (int)getpid());
+    } else {
+        snprintf(socket_path, sizeof(socket_path), "%s/froomf-%d.sock", runtime_dir, (int)getpid());
+    }
+    if (!mtEndpointOpen(&server->endpoint, to_file ? NULL : socket_path)) {
+        fprintf(stderr, "Couldn't serve metrics on %s: %s\n", to_file ? "a pipe" : socket_path, strerror(errno));
+        mtEndpointClose(&server->endpoint);
+        return false;
+    }
+    SDL_AtomicSet(&server->should_run, 1);
+    server->thread = check_ptr(SDL_CreateThread(metrics_server_thread, "metrics", server), "Couldn't create a SDL thread", SDL_GetError());
+    DEBUG_SHOW_LOC("Serving metrics on %s\n", to_file ? server->file_path : socket_path);
+    return true;
+#else
+    (void)server, (void)metrics;
+    fprintf(stderr, "%s is not supported on Windows\n", METRICS_ENV_VAR);
     return false;
+#endif
+}
+
+// Stop the thread and remove the socket or file.
+void metrics_server_stop(MetricsServer* server) {
+#ifndef _WIN32
+    SDL_AtomicSet(&server->should_run, 0);
+    mtEndpointWakeup(&server->endpoint);
+    SDL_WaitThread(server->thread, NULL);
+    mtEndpointClose(&server->endpoint);
+    if (server->file_path[0]) {
+        remove(server->file_path);
+    }
+#else
+    (void)server;
+#endif
 }
 
-bool has_leading_nonblank_char(char** character_set, size_t character_set_len, char* curr_line) {
+int centered_window_x_position(int user_screen_width, int window_width) {
+    return (user_screen_width / 2) - (window_width / 2);
+}
 
-    for (size_t i = 0; i < character_set_len; i++) {
+void initialize_string_array(char** array, size_t array_max_size, size_t max_strlen) {
+    for (size_t i = 0; i < array_max_size; i++) {
+        array[i] = (char*)malloc(max_strlen);
+    }
+}
 
-        char* character = character_set[i];
-        char* line = curr_line;
+void destroy_string_array(char** array, size_t array_max_size) {
+    for (size_t i = 0; i < array_max_size; i++) {
+        free(array[i]);
+    }
+}
+
+// Re-register the config file and every target path with the watcher. The
+// config file always gets id 0, and target i gets id i + 1.
+size_t watch_config_and_targets(FW_Watcher* watcher, const char* conf_file_path, char** target_paths_array, size_t target_paths_count) {
+    fwUnwatchAll(watcher);
+    size_t conf_file_watch_id = fwWatchPath(watcher, conf_file_path);
+    for (size_t i = 0; i < target_paths_count; i++) {
+        fwWatchPath(watcher, target_paths_array[i]);
+    }
+    return conf_file_watch_id;
+}
+
+// Runs every scan off the UI thread. The UI posts requests, the scan thread
+// parses into its back snapshot and hands it over through `ready`, then posts
+// a scan_done_event_type event. The UI keeps drawing its own front snapshot
+// until it takes the new one, and a request that arrives mid-scan cancels the
+// scan in flight. Three snapshots rotate between the front (UI), back (scan
+// thread) and ready/spare slots, so neither side waits on the other.
+typedef struct {
+    SDL_Thread* thread;
+    SDL_mutex* mutex; // guards the pending request, ready, spare and should_stop
+    SDL_cond* request_available;
+    Uint32 scan_done_event_type;
+    Diagnostics* diagnostics;
+    Metrics* metrics;
+    atomic_int generation; // bumped by every request
+    bool should_stop;
+
+    bool request_pending;
+    bool pending_reconfigure; // the config changed: take the pending targets, keywords and mmap_targets
+    bool pending_rescan_all;  // keywords or mmap_targets changed, so no cached result can be trusted
+    bool pending_changed[MAX_TARGET_PATHS];
+    bool pending_use_mmap;
+    char* pending_target_paths_array[MAX_TARGET_PATHS];
+    size_t pending_target_paths_count;
+    char* pending_keywords_array[MAX_KEYWORDS];
+    size_t pending_keywords_count;
+
+    // owned by the scan thread
+    char* target_paths_array[MAX_TARGET_PATHS];
+    size_t target_paths_count;
+    char* keywords_array[MAX_KEYWORDS];
+    size_t keywords_count;
+    ScanCache cache;
+    SC_KeywordMatcher keyword_matcher;
+    WorkerPool pool;
+    EntrySnapshot* back;
+
+    EntrySnapshot* ready; // finished, not yet taken by the UI
+    EntrySnapshot* spare; // handed back by the UI
+    EntrySnapshot snapshots[3];
+} ScanThread;
+
+int scan_thread_main(void* args) {
+    ScanThread* scan_thread = (ScanThread*)args;
+    trSetThreadName("scan");
+
+    SDL_LockMutex(scan_thread->mutex);
+    while (true) {
+        while (!scan_thread->should_stop && !scan_thread->request_pending) {
+            SDL_CondWait(scan_thread->request_available, scan_thread->mutex);
+        }
+        if (scan_thread->should_stop) {
+            break;
+        }
 
-        while (line && *line != '\0') {
-            if (strncmp(line, " ", 1) == 0) { // if space, skip char
-                line++;
-                continue;
+        // take the request
+        Uint64 scan_started = SDL_GetPerformanceCounter();
+        uint64_t traced = trBegin();
+        SC_Cancellation cancellation = {&scan_thread->generation, atomic_load(&scan_thread->generation)};
+        bool reconfigure = scan_thread->pending_reconfigure;
+        bool rescan_all = scan_thread->pending_rescan_all;
+        bool changed[MAX_TARGET_PATHS];
+        memcpy(changed, scan_thread->pending_changed, sizeof(changed));
+        if (reconfigure) {
+            for (size_t i = 0; i < scan_thread->pending_target_paths_count; i++) {
+                snprintf(scan_thread->target_paths_array[i], MAX_STRING_LENGTH_CAPACITY, "%s", scan_thread->pending_target_paths_array[i]);
             }
+            scan_thread->target_paths_count = scan_thread->pending_target_paths_count;
+            for (size_t i = 0; i < scan_thread->pending_keywords_count; i++) {
+                snprintf(scan_thread->keywords_array[i], MAX_STRING_LENGTH_CAPACITY, "%s", scan_thread->pending_keywords_array[i]);
+            }
+            scan_thread->keywords_count = scan_thread->pending_keywords_count;
+            scan_thread->cache.use_mmap = scan_thread->pending_use_mmap;
+        }
+        scan_thread->request_pending = false;
+        scan_thread->pending_reconfigure = false;
+        scan_thread->pending_rescan_all = false;
+        memset(scan_thread->pending_changed, 0, sizeof(scan_thread->pending_changed));
+        SDL_UnlockMutex(scan_thread->mutex);
+
+        if (rescan_all) {
+            scKeywordMatcherDestroy(&scan_thread->keyword_matcher);
+            scKeywordMatcherCompile(&scan_thread->keyword_matcher, scan_thread->keywords_array, scan_thread->keywords_count);
+            DEBUG_SHOW_LOC("Compiled %zu keywords (%s scan kernel)\n", scan_thread->keywords_count, ksKernelName(&scan_thread->keyword_matcher.prefilter));
+            scan_cache_clear(&scan_thread->cache);
+            diagnostics_resolve(scan_thread->diagnostics, "missing:"); // dropped targets are no longer a problem
+        } else if (reconfigure) { // only the target list changed, files still in it keep their results
+            scan_cache_retain(&scan_thread->cache, scan_thread->target_paths_array, scan_thread->target_paths_count, scan_thread->diagnostics);
+            for (size_t i = 0; i < scan_thread->target_paths_count; i++) {
+                if (changed[i]) { // reported by the watcher, parse it even if its stat looks the same
+                    scan_cache_lookup(&scan_thread->cache, scan_thread->target_paths_array[i])->valid = false;
+                }
+            }
+        }
+        size_t files_parsed;
+        Uint64 bytes_parsed;
+        size_t refreshed_count = scan_cache_refresh_targets(&scan_thread->cache, scan_thread->target_paths_array, scan_thread->target_paths_count,
+                                                            reconfigure ? NULL : changed, &scan_thread->keyword_matcher, &scan_thread->pool, &cancellation,
+                                                            scan_thread->diagnostics, &files_parsed, &bytes_parsed);
+        bool publish = (refreshed_count > 0 || reconfigure) && !scCancelled(&cancellation);
+        if (publish) {
+            EntrySnapshot* back = scan_thread->back;
+            uint64_t merge_traced = trBegin();
+            merge_scan_results_into_snapshot(&scan_thread->cache, scan_thread->target_paths_array, scan_thread->target_paths_count,
+                                             scan_thread->keywords_array, scan_thread->keywords_count, back);
+            trEnd("merge_scan_results_into_snapshot", merge_traced, NULL);
+            back->scan_ms = (double)(SDL_GetPerformanceCounter() - scan_started) * 1000.0 / SDL_GetPerformanceFrequency();
+            back->bytes_parsed = bytes_parsed;
+            back->files_parsed = files_parsed;
+            back->file_count = scan_thread->target_paths_count;
+        }
+        trEnd("scan", traced, scCancelled(&cancellation) ? "cancelled" : NULL);
+        if (!scCancelled(&cancellation)) {
+            mtAdd(&scan_thread->metrics->rescans, 1);
+            mtAdd(&scan_thread->metrics->files_scanned, files_parsed);
+            mtAdd(&scan_thread->metrics->bytes_read, bytes_parsed);
+            mtObserve(&scan_thread->metrics->scan_seconds, (SDL_GetPerformanceCounter() - scan_started) * 1000000000.0 / SDL_GetPerformanceFrequency());
+        }
 
-            if (strncmp(line, character, strlen(character)) == 0) {
-                return true;
-            } else { // if not comment char, skip char
-                line++;
-                continue;
+        SDL_LockMutex(scan_thread->mutex);
+        if (publish) {
+            EntrySnapshot* finished = scan_thread->back;
+            if (scan_thread->ready) { // the UI skipped that one
+                scan_thread->back = scan_thread->ready;
+            } else {
+                scan_thread->back = scan_thread->spare;
+                scan_thread->spare = NULL;
             }
+            scan_thread->ready = finished;
+
+            SDL_Event scan_done_event;
+            memset(&scan_done_event, 0, sizeof(scan_done_event));
+            scan_done_event.type = scan_thread->scan_done_event_type;
+            SDL_PushEvent(&scan_done_event);
         }
     }
-    return false;
+    SDL_UnlockMutex(scan_thread->mutex);
+    trThreadExit();
+    return 0;
+}
+
+// Start the scan thread. *front gets the snapshot the UI draws from, empty
+// (not complete) until the first scan finishes.
+void scan_thread_start(ScanThread* scan_thread, Uint32 scan_done_event_type, Diagnostics* diagnostics, Metrics* metrics, EntrySnapshot** front) {
+    memset(scan_thread, 0, sizeof(*scan_thread));
+    scan_thread->diagnostics = diagnostics;
+    scan_thread->metrics = metrics;
+    scan_thread->mutex = check_ptr(SDL_CreateMutex(), "Couldn't create a SDL mutex", SDL_GetError());
+    scan_thread->request_available = check_ptr(SDL_CreateCond(), "Couldn't create a SDL condition variable", SDL_GetError());
+    scan_thread->scan_done_event_type = scan_done_event_type;
+
+    initialize_string_array(scan_thread->pending_target_paths_array, MAX_TARGET_PATHS, MAX_STRING_LENGTH_CAPACITY);
+    initialize_string_array(scan_thread->pending_keywords_array, MAX_KEYWORDS, MAX_STRING_LENGTH_CAPACITY);
+    initialize_string_array(scan_thread->target_paths_array, MAX_TARGET_PATHS, MAX_STRING_LENGTH_CAPACITY);
+    initialize_string_array(scan_thread->keywords_array, MAX_KEYWORDS, MAX_STRING_LENGTH_CAPACITY);
+    scKeywordMatcherCompile(&scan_thread->keyword_matcher, scan_thread->keywords_array, 0);
+    worker_pool_init(&scan_thread->pool);
+
+    for (size_t i = 0; i < 3; i++) {
+        entry_snapshot_init(&scan_thread->snapshots[i]);
+    }
+    *front = &scan_thread->snapshots[0];
+    scan_thread->back = &scan_thread->snapshots[1];
+    scan_thread->spare = &scan_thread->snapshots[2];
+
+    scan_thread->thread = check_ptr(SDL_CreateThread(scan_thread_main, "scan", scan_thread), "Couldn't create a SDL thread", SDL_GetError());
+}
+
+// Must be called with the mutex held.
+void scan_thread_submit_locked(ScanThread* scan_thread) {
+    scan_thread->request_pending = true;
+    atomic_fetch_add(&scan_thread->generation, 1); // cancels the scan in flight, if any
+    SDL_CondSignal(scan_thread->request_available);
+}
+
+// Switch to a new set of targets, keywords and mmap_targets. With rescan_all
+// every target is parsed from scratch, otherwise only targets that are new or
+// changed on disk are parsed.
+void scan_thread_request_reconfigure(ScanThread* scan_thread, char** target_paths_array, size_t target_paths_count, char** keywords_array, size_t keywords_count, bool use_mmap,
+                                     bool rescan_all) {
+    SDL_LockMutex(scan_thread->mutex);
+    // pending changed flags index the previous target list, move them over to the new one by path
+    char** previous_target_paths_array = scan_thread->pending_reconfigure ? scan_thread->pending_target_paths_array : scan_thread->target_paths_array;
+    size_t previous_target_paths_count = scan_thread->pending_reconfigure ? scan_thread->pending_target_paths_count : scan_thread->target_paths_count;
+    bool changed[MAX_TARGET_PATHS] = {0};
+    for (size_t i = 0; i < previous_target_paths_count; i++) {
+        for (size_t j = 0; j < target_paths_count && scan_thread->pending_changed[i]; j++) {
+            changed[j] |= strcmp(previous_target_paths_array[i], target_paths_array[j]) == 0;
+        }
+    }
+    memcpy(scan_thread->pending_changed, changed, sizeof(changed));
+
+    for (size_t i = 0; i < target_paths_count; i++) {
+        snprintf(scan_thread->pending_target_paths_array[i], MAX_STRING_LENGTH_CAPACITY, "%s", target_paths_array[i]);
+    }
+    scan_thread->pending_target_paths_count = target_paths_count;
+    for (size_t i = 0; i < keywords_count; i++) {
+        snprintf(scan_thread->pending_keywords_array[i], MAX_STRING_LENGTH_CAPACITY, "%s", keywords_array[i]);
+    }
+    scan_thread->pending_keywords_count = keywords_count;
+    scan_thread->pending_use_mmap = use_mmap;
+    scan_thread->pending_reconfigure = true;
+    scan_thread->pending_rescan_all |= rescan_all;
+    scan_thread_submit_locked(scan_thread);
+    SDL_UnlockMutex(scan_thread->mutex);
+}
+
+// Re-parse the targets flagged in changed (indices into the last requested
+// target list). Flags from requests that weren't picked up yet accumulate.
+void scan_thread_request_changed(ScanThread* scan_thread, const bool* changed, size_t target_paths_count) {
+    SDL_LockMutex(scan_thread->mutex);
+    for (size_t i = 0; i < target_paths_count; i++) {
+        scan_thread->pending_changed[i] |= changed[i];
+    }
+    scan_thread_submit_locked(scan_thread);
+    SDL_UnlockMutex(scan_thread->mutex);
+}
+
+// Swap in the latest finished snapshot, if there is one. Returns whether
+// *front changed.
+bool scan_thread_take_snapshot(ScanThread* scan_thread, EntrySnapshot** front) {
+    SDL_LockMutex(scan_thread->mutex);
+    bool taken = scan_thread->ready != NULL;
+    if (taken) {
+        scan_thread->spare = *front;
+        *front = scan_thread->ready;
+        scan_thread->ready = NULL;
+    }
+    SDL_UnlockMutex(scan_thread->mutex);
+    return taken;
+}
+
+void scan_thread_stop(ScanThread* scan_thread) {
+    SDL_LockMutex(scan_thread->mutex);
+    scan_thread->should_stop = true;
+    atomic_fetch_add(&scan_thread->generation, 1);
+    SDL_CondSignal(scan_thread->request_available);
+    SDL_UnlockMutex(scan_thread->mutex);
+    SDL_WaitThread(scan_thread->thread, NULL);
+
+    worker_pool_destroy(&scan_thread->pool);
+    scan_cache_destroy(&scan_thread->cache);
+    scKeywordMatcherDestroy(&scan_thread->keyword_matcher);
+    for (size_t i = 0; i < 3; i++) {
+        entry_snapshot_destroy(&scan_thread->snapshots[i]);
+    }
+    destroy_string_array(scan_thread->pending_target_paths_array, MAX_TARGET_PATHS);
+    destroy_string_array(scan_thread->pending_keywords_array, MAX_KEYWORDS);
+    destroy_string_array(scan_thread->target_paths_array, MAX_TARGET_PATHS);
+    destroy_string_array(scan_thread->keywords_array, MAX_KEYWORDS);
+    SDL_DestroyCond(scan_thread->request_available);
+    SDL_DestroyMutex(scan_thread->mutex);
+}
+
+typedef struct {
+    FW_Watcher* watcher;
+    SDL_mutex* watcher_mutex; // guards the watcher's entries, fwWait() runs without it
+    Uint32 file_watch_event_type;
+    SDL_atomic_t should_run;
+} FileWatchThreadArgs;
+
+// Sleeps in fwWait() and posts a file_watch_event_type user event whenever a
+// watched file changes. Only wakes up on a timer while some file has to be
+// stat polled.
+int file_watch_thread(void* args) {
+    FileWatchThreadArgs* wargs = (FileWatchThreadArgs*)args;
+    trSetThreadName("file_watch");
+
+    while (SDL_AtomicGet(&wargs->should_run)) {
+        SDL_LockMutex(wargs->watcher_mutex);
+        int timeout_ms = fwIsPolling(wargs->watcher) ? STAT_POLL_INTERVAL_MS : -1;
+        SDL_UnlockMutex(wargs->watcher_mutex);
+
+        fwWait(wargs->watcher, timeout_ms);
+
+        SDL_LockMutex(wargs->watcher_mutex);
+        uint64_t traced = trBegin();
+        size_t changed_count = fwPoll(wargs->watcher);
+        trEnd("fwPoll", traced, NULL);
+        SDL_UnlockMutex(wargs->watcher_mutex);
+
+        if (changed_count > 0) {
+            SDL_Event file_watch_event;
+            memset(&file_watch_event, 0, sizeof(file_watch_event));
+            file_watch_event.type = wargs->file_watch_event_type;
+            SDL_PushEvent(&file_watch_event);
+        }
+    }
+    trThreadExit();
+    return 0;
+}
+
+// A rasterized line of text, keyed by everything that affects its pixels.
+typedef struct {
+    Uint64 hash;
+    char* text;
+    TTF_Font* font;
+    int font_size;
+    Uint32 color;      // packed RGBA
+    Uint32 background; // packed RGBA, only used when shaded
+    bool shaded;
+    SDL_Texture* texture;
+    int width;
+    int height;
+    size_t bytes;
+    int lru_prev; // towards the most recently used entry, -1 at the head
+    int lru_next; // towards the least recently used entry, -1 at the tail; free list link for unused slots
+    int bucket_next;
+} TextTextureEntry;
+
+// Textures of rendered text lines for one renderer, so a redraw is only an
+// SDL_RenderCopy per line and TTF rasterization happens when a line's text
+// (or font, size or color) changes. Least recently used textures are evicted
+// once they take more than budget_bytes.
+typedef struct {
+    SDL_Renderer* renderer;
+    TextTextureEntry* entries;
+    size_t entry_count; // slots handed out so far, used or free
+    size_t entry_capacity;
+    int* buckets; // hash % bucket_count -> first entry, -1 for none
+    size_t bucket_count;
+    int lru_head;
+    int lru_tail;
+    int free_head;
+    size_t live_count;
+    size_t bytes_used;
+    size_t budget_bytes;
+    size_t hits;
+    size_t misses; // every miss creates a glyph surface and a texture
+} TextTextureCache;
+
+Uint32 pack_sdl_color(SDL_Color color) {
+    return ((Uint32)color.r << 24) | ((Uint32)color.g << 16) | ((Uint32)color.b << 8) | (Uint32)color.a;
+}
+
+// FNV-1a over the text, then the rest of the key folded in.
+Uint64 text_texture_key_hash(const char* text, TTF_Font* font, int font_size, Uint32 color, Uint32 background, bool shaded) {
+    Uint64 hash = 1469598103934665603ULL;
+    for (const unsigned char* ch = (const unsigned char*)text; *ch; ch++) {
+        hash = (hash ^ *ch) * 1099511628211ULL;
+    }
+    Uint64 extras[] = {(Uint64)(uintptr_t)font, (Uint64)font_size, color, shaded ? background : 0, shaded};
+    for (size_t i = 0; i < sizeof(extras) / sizeof(extras[0]); i++) {
+        hash = (hash ^ extras[i]) * 1099511628211ULL;
+    }
+    return hash;
+}
+
+void text_texture_cache_init(TextTextureCache* cache, SDL_Renderer* renderer, size_t budget_bytes) {
+    memset(cache, 0, sizeof(*cache));
+    cache->renderer = renderer;
+    cache->bucket_count = 64;
+    cache->buckets = check_ptr(malloc(cache->bucket_count * sizeof(int)), "Couldn't allocate the texture cache", "out of memory");
+    for (size_t i = 0; i < cache->bucket_count; i++) {
+        cache->buckets[i] = -1;
+    }
+    cache->lru_head = -1;
+    cache->lru_tail = -1;
+    cache->free_head = -1;
+    cache->budget_bytes = budget_bytes;
 }
 
-size_t extract_config_values(char* keyword, char** destination_array, size_t destination_array_length, char** source_array, size_t source_array_length) {
+void text_texture_cache_lru_unlink(TextTextureCache* cache, int index) {
+    TextTextureEntry* entry = &cache->entries[index];
+    if (entry->lru_prev >= 0) {
+        cache->entries[entry->lru_prev].lru_next = entry->lru_next;
+    } else {
+        cache->lru_head = entry->lru_next;
+    }
+    if (entry->lru_next >= 0) {
+        cache->entries[entry->lru_next].lru_prev = entry->lru_prev;
+    } else {
+        cache->lru_tail = entry->lru_prev;
+    }
+}
+
+void text_texture_cache_lru_push_front(TextTextureCache* cache, int index) {
+    TextTextureEntry* entry = &cache->entries[index];
+    entry->lru_prev = -1;
+    entry->lru_next = cache->lru_head;
+    if (cache->lru_head >= 0) {
+        cache->entries[cache->lru_head].lru_prev = index;
+    }
+    cache->lru_head = index;
+    if (cache->lru_tail < 0) {
+        cache->lru_tail = index;
+    }
+}
 
-    size_t destination_array_index = 0;
+void text_texture_cache_remove(TextTextureCache* cache, int index) {
+    TextTextureEntry* entry = &cache->entries[index];
+
+    int* link = &cache->buckets[entry->hash % cache->bucket_count];
+    while (*link != index) {
+        link = &cache->entries[*link].bucket_next;
+    }
+    *link = entry->bucket_next;
+    text_texture_cache_lru_unlink(cache, index);
+
+    SDL_DestroyTexture(entry->texture);
+    free(entry->text);
+    cache->bytes_used -= entry->bytes;
+    cache->live_count--;
+
+    memset(entry, 0, sizeof(*entry));
+    entry->lru_next = cache->free_head;
+    cache->free_head = index;
+}
+
+// Drop least recently used textures until the cache fits its budget. The
+// most recent entry is always kept, so a single line larger than the budget
+// still gets drawn from the cache.
+void text_texture_cache_trim(TextTextureCache* cache) {
+    while (cache->bytes_used > cache->budget_bytes && cache->lru_tail >= 0 && cache->lru_tail != cache->lru_head) {
+        text_texture_cache_remove(cache, cache->lru_tail);
+    }
+}
+
+void text_texture_cache_set_budget(TextTextureCache* cache, size_t budget_bytes) {
+    cache->budget_bytes = budget_bytes;
+    text_texture_cache_trim(cache);
+}
+
+// Forget every texture rendered with font, it's about to be closed (and a
+// later font may be allocated at the same address).
+void text_texture_cache_forget_font(TextTextureCache* cache, TTF_Font* font) {
+    for (size_t i = 0; i < cache->entry_count; i++) {
+        if (cache->entries[i].texture && cache->entries[i].font == font) {
+            text_texture_cache_remove(cache, (int)i);
+        }
+    }
+}
 
-    for (size_t i = 0; i < source_array_length; i++) {
+void text_texture_cache_destroy(TextTextureCache* cache) {
+    for (size_t i = 0; i < cache->entry_count; i++) {
+        if (cache->entries[i].texture) {
+            SDL_DestroyTexture(cache->entries[i].texture);
+            free(cache->entries[i].text);
+        }
+    }
+    free(cache->entries);
+    free(cache->buckets);
+    memset(cache, 0, sizeof(*cache));
+}
 
-        // copy the substring within quotes if it is to the right the keyword (into the destination array)
-        if (destination_array_index < destination_array_length && strstr(source_array[i], keyword) != NULL) { // and keyword in source array
+void text_texture_cache_grow_buckets(TextTextureCache* cache) {
+    size_t new_bucket_count = cache->bucket_count * 2;
+    int* new_buckets = check_ptr(malloc(new_bucket_count * sizeof(int)), "Couldn't grow the texture cache", "out of memory");
+    for (size_t i = 0; i < new_bucket_count; i++) {
+        new_buckets[i] = -1;
+    }
+    for (size_t i = 0; i < cache->entry_count; i++) {
+        TextTextureEntry* entry = &cache->entries[i];
+        if (entry->texture) {
+            size_t bucket = entry->hash % new_bucket_count;
+            entry->bucket_next = new_buckets[bucket];
+            new_buckets[bucket] = (int)i;
+        }
+    }
+    free(cache->buckets);
+    cache->buckets = new_buckets;
+    cache->bucket_count = new_bucket_count;
+}
 
-            char* comment_chars[] = {"#", ";"}; // change comment characters here!
-            if (has_leading_nonblank_char(comment_chars, sizeof(comment_chars) / sizeof(comment_chars[0]), source_array[i])) {
-                continue;
+// Look up the texture for a line of text, rasterizing it on a miss. With a
+// background the text is rendered shaded, otherwise blended.
+TextTextureEntry* text_texture_cache_get(TextTextureCache* cache, TTF_Font* font, int font_size, const char* text, SDL_Color color, const SDL_Color* background) {
+    bool shaded = background != NULL;
+    Uint32 packed_color = pack_sdl_color(color);
+    Uint32 packed_background = shaded ? pack_sdl_color(*background) : 0;
+    Uint64 hash = text_texture_key_hash(text, font, font_size, packed_color, packed_background, shaded);
+
+    for (int i = cache->buckets[hash % cache->bucket_count]; i >= 0; i = cache->entries[i].bucket_next) {
+        TextTextureEntry* entry = &cache->entries[i];
+        if (entry->hash == hash && entry->font == font && entry->font_size == font_size && entry->color == packed_color &&
+            entry->shaded == shaded && entry->background == packed_background && strcmp(entry->text, text) == 0) {
+            if (cache->lru_head != i) {
+                text_texture_cache_lru_unlink(cache, i);
+                text_texture_cache_lru_push_front(cache, i);
             }
+            cache->hits++;
+            return entry;
+        }
+    }
+    cache->misses++;
+
+    SDL_Surface* text_surface;
+    if (shaded) {
+        text_surface = check_ptr(TTF_RenderText_Shaded(font, text, color, *background), "Error loading a font text surface", TTF_GetError());
+    } else {
+        text_surface = check_ptr(TTF_RenderText_Blended(font, text, color), "Error loading a font text surface", TTF_GetError());
+    }
+    SDL_Texture* text_texture = check_ptr(SDL_CreateTextureFromSurface(cache->renderer, text_surface), "Couldn't create a SDL texture", SDL_GetError());
+
+    int index;
+    if (cache->free_head >= 0) {
+        index = cache->free_head;
+        cache->free_head = cache->entries[index].lru_next;
+    } else {
+        if (cache->entry_count == cache->entry_capacity) {
+            size_t new_capacity = cache->entry_capacity ? cache->entry_capacity * 2 : 64;
+            cache->entries = check_ptr(realloc(cache->entries, new_capacity * sizeof(TextTextureEntry)), "Couldn't grow the texture cache", "out of memory");
+            cache->entry_capacity = new_capacity;
+        }
+        index = (int)cache->entry_count++;
+    }
+    if (cache->live_count + 1 > cache->bucket_count) {
+        text_texture_cache_grow_buckets(cache);
+    }
+
+    TextTextureEntry* entry = &cache->entries[index];
+    entry->hash = hash;
+    entry->text = check_ptr(strdup(text), "Couldn't copy the text", "out of memory");
+    entry->font = font;
+    entry->font_size = font_size;
+    entry->color = packed_color;
+    entry->background = packed_background;
+    entry->shaded = shaded;
+    entry->texture = text_texture;
+    entry->width = text_surface->w;
+    entry->height = text_surface->h;
+    entry->bytes = (size_t)text_surface->w * text_surface->h * 4;
+    SDL_FreeSurface(text_surface);
+
+    size_t bucket = hash % cache->bucket_count;
+    entry->bucket_next = cache->buckets[bucket];
+    cache->buckets[bucket] = index;
+    text_texture_cache_lru_push_front(cache, index);
+    cache->live_count++;
+    cache->bytes_used += entry->bytes;
+
+    text_texture_cache_trim(cache);
+    return entry;
+}
+
+void render_text_line(TextTextureCache* cache, TTF_Font* font, int font_size, const char* text, SDL_Color color, const SDL_Color* background, int* y_offset, float zoom_scale) {
+    TextTextureEntry* entry = text_texture_cache_get(cache, font, font_size, text, color, background);
+    SDL_Rect src_rect = {0, 0, entry->width, entry->height};
+    SDL_Rect dst_rect = {0, *y_offset, entry->width * zoom_scale, entry->height * zoom_scale};
+    SDL_RenderCopy(cache->renderer, entry->texture, &src_rect, &dst_rect);
+
+    *y_offset += entry->height * zoom_scale;
+}
+
+// Draw a highlighted status line in the top right corner, over the entries.
+void render_status_badge(TextTextureCache* cache, TTF_Font* font, int font_size, const char* text, SDL_Color background_color, float zoom_scale) {
+    SDL_Color text_color = {255, 255, 255, 255};
+    TextTextureEntry* entry = text_texture_cache_get(cache, font, font_size, text, text_color, &background_color);
+
+    int viewport_width, viewport_height;
+    SDL_GetRendererOutputSize(cache->renderer, &viewport_width, &viewport_height);
+    SDL_Rect src_rect = {0, 0, entry->width, entry->height};
+    SDL_Rect dst_rect = {0, 0, entry->width * zoom_scale, entry->height * zoom_scale};
+    dst_rect.x = viewport_width > dst_rect.w ? viewport_width - dst_rect.w : 0;
+    SDL_RenderCopy(cache->renderer, entry->texture, &src_rect, &dst_rect);
+}
+
+// Numbers behind the F12 performance overlay. Keeping them is a couple of
+// counters and timestamps per frame and per wakeup, so it is always compiled in;
+// only drawing it costs anything, and only while it is visible.
+typedef struct {
+    bool visible;
+    Uint32 drawn_ticks;
+    double frame_ms;     // the last frame, from clearing to presenting
+    size_t frame_misses; // text textures (each with its glyph surface) created by the last frame
+    Uint32 window_started_ticks; // wakeups are counted over PERF_HUD_REFRESH_MS windows
+    size_t window_wakeups;
+    size_t window_idle_wakeups;
+    double wakeups_per_second;
+    double idle_wakeups_per_second;
+} PerfHud;
+
+// Call once per main loop iteration. idle: it woke up, but had nothing to draw.
+void perf_hud_count_wakeup(PerfHud* hud, bool idle) {
+    hud->window_wakeups++;
+    if (idle) {
+        hud->window_idle_wakeups++;
+    }
+    Uint32 now = SDL_GetTicks();
+    Uint32 elapsed = now - hud->window_started_ticks;
+    if (elapsed >= PERF_HUD_REFRESH_MS) {
+        hud->wakeups_per_second = hud->window_wakeups * 1000.0 / elapsed;
+        hud->idle_wakeups_per_second = hud->window_idle_wakeups * 1000.0 / elapsed;
+        hud->window_wakeups = 0;
+        hud->window_idle_wakeups = 0;
+        hud->window_started_ticks = now;
+    }
+}
+
+// Whether a visible HUD is due for new numbers.
+bool perf_hud_refresh_due(const PerfHud* hud) {
+    return hud->visible && SDL_GetTicks() - hud->drawn_ticks >= PERF_HUD_REFRESH_MS;
+}
+
+// Draw the HUD in the bottom left corner. Its text changes every frame, so it
+// is rasterized straight to throwaway textures instead of going through (and
+// showing up in) the text texture cache.
+void perf_hud_draw(PerfHud* hud, SDL_Renderer* renderer, TTF_Font* font, const EntrySnapshot* snapshot, const TextTextureCache* text_texture_cache) {
+    char lines[3][MAX_STRING_LENGTH_CAPACITY];
+    snprintf(lines[0], sizeof(lines[0]), "scan %.2f ms, %.1f KiB read, %zu/%zu files parsed, %zu matches", snapshot->scan_ms, snapshot->bytes_parsed / 1024.0,
+             snapshot->files_parsed, snapshot->file_count, snapshot->entry_count);
+    snprintf(lines[1], sizeof(lines[1]), "frame %.2f ms, %zu textures + glyph surfaces created, %zu cached (%zu KiB)", hud->frame_ms, hud->frame_misses,
+             text_texture_cache->live_count, text_texture_cache->bytes_used / 1024);
+    snprintf(lines[2], sizeof(lines[2]), "wakeups %.1f/s, %.1f/s idle", hud->wakeups_per_second, hud->idle_wakeups_per_second);
+
+    int viewport_width, viewport_height;
+    SDL_GetRendererOutputSize(renderer, &viewport_width, &viewport_height);
+    SDL_Color text_color = {255, 255, 255, 255};
+    SDL_Color background_color = {0, 0, 0, 255};
+    int y = viewport_height;
+    for (int i = 2; i >= 0; i--) {
+        SDL_Surface* surface = TTF_RenderText_Shaded(font, lines[i], text_color, background_color);
+        if (!surface) {
+            continue;
+        }
+        SDL_Texture* texture = SDL_CreateTextureFromSurface(renderer, surface);
+        if (texture) {
+            SDL_Rect dst_rect = {0, 0, surface->w * PERF_HUD_SCALE, surface->h * PERF_HUD_SCALE};
+            y -= dst_rect.h;
+            dst_rect.y = y;
+            SDL_RenderCopy(renderer, texture, NULL, &dst_rect);
+            SDL_DestroyTexture(texture);
+        }
+        SDL_FreeSurface(surface);
+    }
+    hud->drawn_ticks = SDL_GetTicks();
+}
+
+// Number of rows of row_height pixels, stacked from the top, that are at
+// least partly inside a viewport of viewport_height pixels.
+size_t visible_row_count(int viewport_height, int row_height, size_t row_count) {
+    if (viewport_height <= 0) {
+        return 0;
+    }
+    if (row_height < 1) {
+        row_height = 1;
+    }
+    size_t rows_in_viewport = ((size_t)viewport_height + row_height - 1) / row_height;
+    return rows_in_viewport < row_count ? rows_in_viewport : row_count;
+}
+
+typedef enum {
+    RENDERER_PREFERENCE_AUTO,
+    RENDERER_PREFERENCE_ACCELERATED,
+    RENDERER_PREFERENCE_SOFTWARE,
+} RendererPreference;
+
+// "software" forces the software renderer, "accelerated" and "auto" (the
+// default) both try the GPU first.
+RendererPreference parse_renderer_preference(char** user_value_array, size_t user_value_count) {
+    if (user_value_count < 1) {
+        return RENDERER_PREFERENCE_AUTO;
+    }
+    if (strcmp(user_value_array[0], "software") == 0) {
+        return RENDERER_PREFERENCE_SOFTWARE;
+    }
+    if (strcmp(user_value_array[0], "accelerated") == 0) {
+        return RENDERER_PREFERENCE_ACCELERATED;
+    }
+    return RENDERER_PREFERENCE_AUTO;
+}
+
+// Create a vsynced hardware renderer unless software rendering was asked for,
+// and fall back to the software renderer when the GPU one can't be created.
+SDL_Renderer* create_renderer(SDL_Window* window_ptr, RendererPreference preference) {
+    SDL_Renderer* renderer_ptr = NULL;
+    if (preference != RENDERER_PREFERENCE_SOFTWARE) {
+        renderer_ptr = SDL_CreateRenderer(window_ptr, -1, SDL_RENDERER_ACCELERATED | SDL_RENDERER_PRESENTVSYNC);
+        if (!renderer_ptr) {
+            DEBUG_SHOW_LOC("Accelerated renderer unavailable (%s), falling back to software\n", SDL_GetError());
+        }
+    }
+    if (!renderer_ptr) {
+        renderer_ptr = check_ptr(SDL_CreateRenderer(window_ptr, -1, SDL_RENDERER_SOFTWARE), "Couldn't create an SDL renderer", SDL_GetError());
+    }
+
+    SDL_RendererInfo renderer_info;
+    if (SDL_GetRendererInfo(renderer_ptr, &renderer_info) == 0) {
+        DEBUG_SHOW_LOC("Renderer backend: %s (%s%s)\n", renderer_info.name,
+                       (renderer_info.flags & SDL_RENDERER_ACCELERATED) ? "accelerated" : "software",
+                       (renderer_info.flags & SDL_RENDERER_PRESENTVSYNC) ? ", vsync" : "");
+    }
+    return renderer_ptr;
+}
+
+float clamp(float value, float min, float max) {
+    if (value < min) {
+        return min;
+    } else if (value > max) {
+        return max;
+    } else {
+        return value;
+    }
+}
+
+size_t calculate_user_entry_offset(size_t default_value, int entry_offset, size_t entry_count) {
+    // (sum % chice_count) to make the result cycle around
+    long idx = (long)default_value + (long)entry_offset;
+    long n = (long)entry_count;
+
+    // bring the value into [0 .. n-1]
+    idx %= n;
+    if (idx < 0)
+        idx += n; // make positive
+
+    return (size_t)idx;
+}
+
+typedef struct {
+    size_t window_width;
+    size_t window_height;
+    size_t window_position_x;
+    size_t window_position_y;
+} WindowParams;
+
+typedef struct {
+    const char* family;
+    const char* style;
+    const char* path;
+    size_t next_face; // next face of the same family, SIZE_MAX for the last one
+} FontFace;
+
+typedef struct {
+    const char* name;
+    size_t first_face;
+    size_t last_face;
+    size_t face_count;
+    size_t regular_face; // what to load when only the family is asked for
+} FontFamily;
+
+// Every font face found, grouped by family (names compared without case).
+// Strings live in the arena, families are looked up through family_slots.
+typedef struct {
+    AR_Arena arena;
+    FontFace* faces;
+    size_t face_count;
+    size_t face_capacity;
+    FontFamily* families;
+    size_t family_count;
+    size_t family_capacity;
+    size_t* family_slots; // open addressing index into families, SIZE_MAX for empty
+    size_t family_slot_count;
+} FontIndex;
+
+void font_index_init(FontIndex* index) {
+    memset(index, 0, sizeof(*index));
+    arInit(&index->arena);
+}
+
+void font_index_destroy(FontIndex* index) {
+    arDestroy(&index->arena);
+    free(index->faces);
+    free(index->families);
+    free(index->family_slots);
+    memset(index, 0, sizeof(*index));
+}
+
+size_t font_family_hash(const char* name) {
+    size_t hash = 2166136261u;
+    for (const char* ch = name; *ch; ch++) {
+        hash = (hash ^ (unsigned char)tolower((unsigned char)*ch)) * 16777619u;
+    }
+    return hash;
+}
 
-            char* char_start_ptr = strchr(source_array[i], '"'); // first quote
-            if (!char_start_ptr)
-                continue;
-            char_start_ptr++; // skip the quote
+void font_index_insert_slot(FontIndex* index, size_t family_id) {
+    size_t slot = font_family_hash(index->families[family_id].name) & (index->family_slot_count - 1);
+    while (index->family_slots[slot] != SIZE_MAX) {
+        slot = (slot + 1) & (index->family_slot_count - 1);
+    }
+    index->family_slots[slot] = family_id;
+}
 
-            char* char_end_ptr = strchr(char_start_ptr, '"'); // matching second quote
-            if (!char_end_ptr)
-                continue;
+FontFamily* font_index_find_family(FontIndex* index, const char* name) {
+    if (index->family_slot_count == 0) {
+        return NULL;
+    }
+    size_t slot = font_family_hash(name) & (index->family_slot_count - 1);
+    while (index->family_slots[slot] != SIZE_MAX) {
+        FontFamily* family = &index->families[index->family_slots[slot]];
+        if (strcasecmp(family->name, name) == 0) {
+            return family;
+        }
+        slot = (slot + 1) & (index->family_slot_count - 1);
+    }
+    return NULL;
+}
 
-            char keyword_value_string[MAX_STRING_LENGTH_CAPACITY];
-            size_t word_length = char_end_ptr - char_start_ptr;
-            snprintf(keyword_value_string, word_length + 1, "%s", char_start_ptr);
+// Lower is more "regular".
+int font_style_rank(const char* style) {
+    if (strcasecmp(style, "Regular") == 0 || strcasecmp(style, "Book") == 0 || strcasecmp(style, "Normal") == 0 || strcasecmp(style, "Roman") == 0) {
+        return 0;
+    }
+    if (style[0] == '\0') {
+        return 1;
+    }
+    if (strcasecmp(style, "Medium") == 0) {
+        return 2;
+    }
+    return 3;
+}
 
-            if (!array_contains_string(destination_array, destination_array_index, keyword_value_string)) { // avoid duplicates
-                snprintf(destination_array[destination_array_index], MAX_STRING_LENGTH_CAPACITY, "%s", keyword_value_string);
+void font_index_add(FontIndex* index, const FF_FontNames* names, const char* font_path) {
+    FontFamily* family = font_index_find_family(index, names->family);
+    if (!family) {
+        if (index->family_capacity < index->family_count + 1) {
+            index->family_capacity = index->family_capacity ? index->family_capacity * 2 : 64;
+            index->families = check_ptr(realloc(index->families, index->family_capacity * sizeof(FontFamily)), "Couldn't grow the font index", "out of memory");
+        }
+        if (index->family_slot_count < index->family_capacity * 2) {
+            free(index->family_slots);
+            index->family_slot_count = index->family_capacity * 2;
+            index->family_slots = check_ptr(malloc(index->family_slot_count * sizeof(size_t)), "Couldn't grow the font index", "out of memory");
+            memset(index->family_slots, 0xff, index->family_slot_count * sizeof(size_t));
+            for (size_t i = 0; i < index->family_count; i++) {
+                font_index_insert_slot(index, i);
             }
-
-            destination_array_index++;
         }
+        family = &index->families[index->family_count];
+        family->name = arStrndup(&index->arena, names->family, strlen(names->family));
+        family->first_face = family->last_face = family->regular_face = SIZE_MAX;
+        family->face_count = 0;
+        font_index_insert_slot(index, index->family_count++);
     }
 
-    return destination_array_index;
+    if (index->face_capacity < index->face_count + 1) {
+        index->face_capacity = index->face_capacity ? index->face_capacity * 2 : 256;
+        index->faces = check_ptr(realloc(index->faces, index->face_capacity * sizeof(FontFace)), "Couldn't grow the font index", "out of memory");
+    }
+    size_t face_id = index->face_count++;
+    FontFace* face = &index->faces[face_id];
+    face->family = family->name;
+    face->style = arStrndup(&index->arena, names->style, strlen(names->style));
+    face->path = arStrndup(&index->arena, font_path, strlen(font_path));
+    face->next_face = SIZE_MAX;
+
+    if (family->first_face == SIZE_MAX) {
+        family->first_face = face_id;
+    } else {
+        index->faces[family->last_face].next_face = face_id;
+    }
+    family->last_face = face_id;
+    family->face_count++;
+    if (family->regular_face == SIZE_MAX || font_style_rank(face->style) < font_style_rank(index->faces[family->regular_face].style)) {
+        family->regular_face = face_id;
+    }
 }
 
-int parse_single_user_value_int(char** user_value_array, size_t user_value_count, int default_value) {
-    if (user_value_count < 1 || !isdigit(user_value_array[0][0])) {
-        return default_value;
+typedef struct {
+    char** font_paths;
+    FF_FontNames* names;
+} FontNamesBatch;
+
+void font_names_job(void* job_data, size_t job_index) {
+    FontNamesBatch* batch = (FontNamesBatch*)job_data;
+    const char* font_path = batch->font_paths[job_index];
+    FF_FontNames* names = &batch->names[job_index];
+
+    // the name table is a few hundred bytes somewhere in the file, a mapping only reads those pages
+    KS_FileData file_data;
+    bool parsed = false;
+    if (ksLoadFile(font_path, true, &file_data)) {
+        parsed = ffParseFontNames((const unsigned char*)file_data.data, file_data.size, names) == 0;
+        ksReleaseFile(&file_data);
+    }
+    if (!parsed) {
+        ffFontNamesFromPath(font_path, names);
     }
-    return atoi(user_value_array[0]);
 }
 
-int parse_single_user_value_bool(char** user_value_array, size_t user_value_count, bool default_value) {
-    if (user_value_count < 1) {
-        return default_value;
+// Read the names of font_count fonts on the pool (the slow part, no lock
+// held), then add them to the index while holding index_mutex (if any).
+void font_index_add_fonts(FontIndex* index, SDL_mutex* index_mutex, char** font_paths, size_t font_count, WorkerPool* pool) {
+    if (font_count == 0) {
+        return;
     }
-    if (strcmp(user_value_array[0], "true") == 0) {
-        return true;
+    uint64_t traced = trBegin();
+    FontNamesBatch batch;
+    batch.font_paths = font_paths;
+    batch.names = check_ptr(malloc(font_count * sizeof(FF_FontNames)), "Couldn't allocate font names", "out of memory");
+    worker_pool_run(pool, font_names_job, &batch, font_count);
+
+    if (index_mutex) {
+        SDL_LockMutex(index_mutex);
     }
-    return false;
+    for (size_t i = 0; i < font_count; i++) {
+        font_index_add(index, &batch.names[i], font_paths[i]);
+    }
+    if (index_mutex) {
+        SDL_UnlockMutex(index_mutex);
+    }
+    free(batch.names);
+    trEnd("font_index_add_fonts", traced, NULL);
 }
 
-int centered_window_x_position(int user_screen_width, int window_width) {
-    return (user_screen_width / 2) - (window_width / 2);
-}
+// Walk the platform font directories through the on-disk listing cache.
+int find_fonts_cached(const FF_StringArray* dirs, FF_FontCallback on_font, void* user) {
+    FF_FontCache font_cache;
+    ffFontCacheInit(&font_cache);
+    char cache_path[MAX_STRING_LENGTH_CAPACITY];
+    bool has_cache_path = ffDefaultCachePath(FONT_CACHE_FILE_NAME, cache_path, sizeof(cache_path)) == 0;
+    if (has_cache_path) {
+        ffFontCacheLoad(&font_cache, cache_path); // a missing or broken cache is just empty
+    }
 
-void initialize_string_array(char** array, size_t array_max_size, size_t max_strlen) {
-    for (size_t i = 0; i < array_max_size; i++) {
-        array[i] = (char*)malloc(max_strlen);
+    uint64_t traced = trBegin();
+    int stopped = ffFindFontsCached(dirs, &font_cache, on_font, user);
+    trEnd("ffFindFontsCached", traced, NULL);
+    if (!stopped && has_cache_path && ffFontCacheSave(&font_cache, cache_path) != 0) {
+        fprintf(stderr, "Couldn't write the font cache to %s\n", cache_path);
     }
+    ffFontCacheDestroy(&font_cache);
+    return stopped;
 }
 
-void destroy_string_array(char** array, size_t array_max_size) {
-    for (size_t i = 0; i < array_max_size; i++) {
-        free(array[i]);
-    }
+int append_font_path(const char* font_path, void* user) {
+    ffStringArrayAppend((FF_StringArray*)user, font_path);
+    return 0;
 }
 
-int target_paths_modified(char** target_paths_array, size_t target_paths_count, time_t* last_mtime, bool* target_path_nonexistence_array) {
-    // track the latest modification time from all of the file paths
-    time_t latest_mtime = 0;
+// Find the file to load for a font family, reading the name tables of the
+// installed fonts a chunk at a time until the family shows up (the rest of
+// the chunk is still read, in case it holds the family's regular face).
+// Gives up between chunks once should_stop (if any) is set.
+bool resolve_font_family(const char* family_name, char* font_path, size_t font_path_capacity, WorkerPool* pool, SDL_atomic_t* should_stop) {
+    uint64_t traced = trBegin();
+    FF_StringArray dirs, fonts;
+    ffStringArrayInit(&dirs, 0);
+    ffStringArrayInit(&fonts, 0);
+    ffGetPlatformFontDirs(&dirs);
+    find_fonts_cached(&dirs, append_font_path, &fonts);
+
+    FontIndex index;
+    font_index_init(&index);
+
+    FontFamily* family = NULL;
+    for (size_t first = 0; first < fonts.size && !family && !(should_stop && SDL_AtomicGet(should_stop)); first += FONT_INDEX_CHUNK_SIZE) {
+        size_t chunk = SDL_min((size_t)FONT_INDEX_CHUNK_SIZE, fonts.size - first);
+        font_index_add_fonts(&index, NULL, fonts.items + first, chunk, pool);
+        family = font_index_find_family(&index, family_name);
+    }
+    if (family) {
+        snprintf(font_path, font_path_capacity, "%s", index.faces[family->regular_face].path);
+    }
 
-    for (size_t i = 0; i < target_paths_count; i++) {
+    font_index_destroy(&index);
+    ffStringArrayDestroy(&fonts);
+    ffStringArrayDestroy(&dirs);
+    trEnd("resolve_font_family", traced, family_name);
+    return family != NULL;
+}
 
-        // Logic:
-        //
-        // !file exists && previously exist
-        //     -> update latest "modified time"
-        //     -> update to track file as not existing
-        // file exists && previously not exist
-        //     -> uptate latest "modified time"
-        //     -> update to track file as existing
-        // !file exists && previously not exist
-        //     -> continue as is
-        // file exists && previously exist
-        //     -> check for file modification
-        //     -> continue as is
-
-        if (!file_exists(target_paths_array[i]) && !target_path_nonexistence_array[i]) {
-            target_path_nonexistence_array[i] = true;
-            latest_mtime = time(NULL); // current time
-            break;
+// Resolves font families on its own thread, so a font_family change doesn't
+// hold up the UI while the font directories are walked and the name tables
+// read. The UI posts the family it wants and gets a font_resolved_event_type
+// event once the result can be taken. A request that arrives mid-lookup
+// replaces the one in flight, whose result is dropped.
+typedef struct {
+    SDL_Thread* thread;
+    SDL_mutex* mutex; // guards everything below
+    SDL_cond* request_available;
+    WorkerPool* pool; // shared with the other font lookups
+    Uint32 font_resolved_event_type;
+    SDL_atomic_t should_stop;
+
+    bool request_pending;
+    char requested_family[MAX_STRING_LENGTH_CAPACITY];
+
+    bool result_ready;
+    bool result_found;
+    char result_family[MAX_STRING_LENGTH_CAPACITY];
+    char result_font_path[MAX_STRING_LENGTH_CAPACITY];
+} FontResolver;
+
+int font_resolver_thread(void* args) {
+    FontResolver* resolver = (FontResolver*)args;
+    trSetThreadName("font_resolver");
+
+    SDL_LockMutex(resolver->mutex);
+    while (true) {
+        while (!SDL_AtomicGet(&resolver->should_stop) && !resolver->request_pending) {
+            SDL_CondWait(resolver->request_available, resolver->mutex);
         }
-
-        if (file_exists(target_paths_array[i]) && target_path_nonexistence_array[i]) {
-            target_path_nonexistence_array[i] = false;
-            latest_mtime = time(NULL); // current time
+        if (SDL_AtomicGet(&resolver->should_stop)) {
             break;
         }
-
-        if (!file_exists(target_paths_array[i]) && target_path_nonexistence_array[i]) {
-            continue;
-        }
-
-        struct stat file_stat;
-        check_code(stat(target_paths_array[i], &file_stat), "File modification check failed.");
-
-        if (file_stat.st_mtime > latest_mtime) {
-            latest_mtime = file_stat.st_mtime;
+        char family_name[MAX_STRING_LENGTH_CAPACITY];
+        snprintf(family_name, sizeof(family_name), "%s", resolver->requested_family);
+        resolver->request_pending = false;
+        SDL_UnlockMutex(resolver->mutex);
+
+        char font_path[MAX_STRING_LENGTH_CAPACITY];
+        bool found = resolve_font_family(family_name, font_path, sizeof(font_path), resolver->pool, &resolver->should_stop);
+
+        SDL_LockMutex(resolver->mutex);
+        if (!resolver->request_pending && !SDL_AtomicGet(&resolver->should_stop)) {
+            resolver->result_ready = true;
+            resolver->result_found = found;
+            snprintf(resolver->result_family, sizeof(resolver->result_family), "%s", family_name);
+            snprintf(resolver->result_font_path, sizeof(resolver->result_font_path), "%s", found ? font_path : "");
+
+            SDL_Event font_resolved_event;
+            memset(&font_resolved_event, 0, sizeof(font_resolved_event));
+            font_resolved_event.type = resolver->font_resolved_event_type;
+            SDL_PushEvent(&font_resolved_event);
         }
     }
+    SDL_UnlockMutex(resolver->mutex);
+    trThreadExit();
+    return 0;
+}
 
-    int modified = (*last_mtime) < latest_mtime;
-    if (modified) {
-        *last_mtime = latest_mtime;
-    }
-
-    return modified;
+void font_resolver_start(FontResolver* resolver, Uint32 font_resolved_event_type, WorkerPool* pool) {
+    memset(resolver, 0, sizeof(*resolver));
+    resolver->mutex = check_ptr(SDL_CreateMutex(), "Couldn't create a SDL mutex", SDL_GetError());
+    resolver->request_available = check_ptr(SDL_CreateCond(), "Couldn't create a SDL condition variable", SDL_GetError());
+    resolver->pool = pool;
+    resolver->font_resolved_event_type = font_resolved_event_type;
+    resolver->thread = check_ptr(SDL_CreateThread(font_resolver_thread, "font_resolver", resolver), "Couldn't create a SDL thread", SDL_GetError());
 }
 
-int path_modified(char* file_path, time_t* last_mtime, bool* conf_file_existence, size_t* conf_file_line_count) {
-    // track the latest modification time from all of the file paths
-    time_t latest_mtime = 0;
-    // if first time file unexisted
-    if (!file_exists(file_path) && *conf_file_existence) {
-        time_t now = time(NULL); // current time
-        latest_mtime = now;
-        *conf_file_existence = false;
-        *conf_file_line_count = 0;
-    } else if (!file_exists(file_path) && !*conf_file_existence) { // if previously nonexisted, don't affect the latest modified time
-        *conf_file_line_count = 0;
-        latest_mtime = *last_mtime;
-    } else if (file_exists(file_path)) { // if the file exists
-        *conf_file_existence = true;
-        struct stat file_stat;
-        check_code(stat(file_path, &file_stat), "File modification check failed.");
+void font_resolver_request(FontResolver* resolver, const char* family_name) {
+    SDL_LockMutex(resolver->mutex);
+    snprintf(resolver->requested_family, sizeof(resolver->requested_family), "%s", family_name);
+    resolver->request_pending = true;
+    resolver->result_ready = false; // an older result is stale now
+    SDL_CondSignal(resolver->request_available);
+    SDL_UnlockMutex(resolver->mutex);
+}
 
-        if (file_stat.st_mtime > latest_mtime) { // this is not getting true when config file is created??
-            latest_mtime = file_stat.st_mtime;
+// Take the result of the last request, if it is done. *found tells whether
+// the family is installed; font_path is only set if it is.
+bool font_resolver_take_result(FontResolver* resolver, char* family_name, char* font_path, size_t capacity, bool* found) {
+    SDL_LockMutex(resolver->mutex);
+    bool taken = resolver->result_ready;
+    if (taken) {
+        snprintf(family_name, capacity, "%s", resolver->result_family);
+        if (resolver->result_found) {
+            snprintf(font_path, capacity, "%s", resolver->result_font_path);
         }
+        *found = resolver->result_found;
+        resolver->result_ready = false;
     }
+    SDL_UnlockMutex(resolver->mutex);
+    return taken;
+}
 
-    int modified = (*last_mtime) < latest_mtime;
-    if (modified) {
-        *last_mtime = latest_mtime;
-    }
+// Give up on the lookup in flight, if any, and wait for the thread.
+void font_resolver_stop(FontResolver* resolver) {
+    SDL_LockMutex(resolver->mutex);
+    SDL_AtomicSet(&resolver->should_stop, 1);
+    SDL_CondSignal(resolver->request_available);
+    SDL_UnlockMutex(resolver->mutex);
+    SDL_WaitThread(resolver->thread, NULL);
+    SDL_DestroyCond(resolver->request_available);
+    SDL_DestroyMutex(resolver->mutex);
+}
 
-    return modified;
+// Finds the fonts on its own thread so the font popup can open right away.
+// Font files are appended to `fonts` as the directories are walked (the
+// listings are cached between runs, see find_fonts_cached()), then their
+// names are read on a worker pool and added to `index` a chunk at a time.
+// A fonts_found_event_type event wakes the popup up every
+// FONT_DISCOVERY_EVENT_INTERVAL_MS at most (and once more at the end).
+typedef struct {
+    SDL_Thread* thread;
+    SDL_mutex* mutex; // guards fonts, index, walked, indexed_count and done
+    FF_StringArray dirs;
+    FF_StringArray fonts;
+    FontIndex index;
+    bool walked; // all of fonts was found, indexing it now
+    size_t indexed_count;
+    bool done;
+    SDL_atomic_t should_stop;
+    WorkerPool* pool; // shared with the other font lookups
+    Uint32 fonts_found_event_type;
+    Uint32 last_event_ticks;
+} FontDiscovery;
+
+void font_discovery_notify(FontDiscovery* discovery) {
+    discovery->last_event_ticks = SDL_GetTicks();
+    SDL_Event fonts_found_event;
+    memset(&fonts_found_event, 0, sizeof(fonts_found_event));
+    fonts_found_event.type = discovery->fonts_found_event_type;
+    SDL_PushEvent(&fonts_found_event);
 }
 
-void render_text_line(SDL_Renderer* renderer_ptr, SDL_Surface* text_surface, int* y_offset, float zoom_scale) {
-    SDL_Texture* text_texture = check_ptr(SDL_CreateTextureFromSurface(renderer_ptr, text_surface), "Couldn't create a SDL texture", TTF_GetError());
-    SDL_Rect src_rect = {0, 0, text_surface->w, text_surface->h};
-    SDL_Rect dst_rect = {0, *y_offset, text_surface->w * zoom_scale, text_surface->h * zoom_scale};
-    SDL_RenderCopy(renderer_ptr, text_texture, &src_rect, &dst_rect);
+void font_discovery_maybe_notify(FontDiscovery* discovery) {
+    if (SDL_GetTicks() - discovery->last_event_ticks >= FONT_DISCOVERY_EVENT_INTERVAL_MS) {
+        font_discovery_notify(discovery);
+    }
+}
 
-    *y_offset += text_surface->h * zoom_scale;
+int font_discovery_on_font(const char* font_path, void* user) {
+    FontDiscovery* discovery = (FontDiscovery*)user;
 
-    SDL_FreeSurface(text_surface);
-    SDL_DestroyTexture(text_texture);
-}
+    SDL_LockMutex(discovery->mutex);
+    ffStringArrayAppend(&discovery->fonts, font_path);
+    SDL_UnlockMutex(discovery->mutex);
 
-float clamp(float value, float min, float max) {
-    if (value < min) {
-        return min;
-    } else if (value > max) {
-        return max;
-    } else {
-        return value;
-    }
+    font_discovery_maybe_notify(discovery);
+    return SDL_AtomicGet(&discovery->should_stop);
 }
 
-size_t calculate_user_entry_offset(size_t default_value, int entry_offset, size_t entry_count) {
-    // (sum % chice_count) to make the result cycle around
-    long idx = (long)default_value + (long)entry_offset;
-    long n = (long)entry_count;
+int font_discovery_thread(void* args) {
+    FontDiscovery* discovery = (FontDiscovery*)args;
+    trSetThreadName("font_discovery");
+    find_fonts_cached(&discovery->dirs, font_discovery_on_font, discovery);
+
+    SDL_LockMutex(discovery->mutex);
+    discovery->walked = true;
+    SDL_UnlockMutex(discovery->mutex);
+    font_discovery_notify(discovery);
+
+    // only this thread appends to fonts, so it can read it without the lock from here on
+    for (size_t first = 0; first < discovery->fonts.size && !SDL_AtomicGet(&discovery->should_stop); first += FONT_INDEX_CHUNK_SIZE) {
+        size_t chunk = SDL_min((size_t)FONT_INDEX_CHUNK_SIZE, discovery->fonts.size - first);
+        font_index_add_fonts(&discovery->index, discovery->mutex, discovery->fonts.items + first, chunk, discovery->pool);
+
+        SDL_LockMutex(discovery->mutex);
+        discovery->indexed_count = first + chunk;
+        SDL_UnlockMutex(discovery->mutex);
+        font_discovery_maybe_notify(discovery);
+    }
 
-    // bring the value into [0 .. n-1]
-    idx %= n;
-    if (idx < 0)
-        idx += n; // make positive
+    SDL_LockMutex(discovery->mutex);
+    discovery->done = true;
+    SDL_UnlockMutex(discovery->mutex);
+    font_discovery_notify(discovery);
+    trThreadExit();
+    return 0;
+}
 
-    return (size_t)idx;
+void font_discovery_start(FontDiscovery* discovery, Uint32 fonts_found_event_type, WorkerPool* pool) {
+    memset(discovery, 0, sizeof(*discovery));
+    discovery->mutex = check_ptr(SDL_CreateMutex(), "Couldn't create a SDL mutex", SDL_GetError());
+    discovery->pool = pool;
+    discovery->fonts_found_event_type = fonts_found_event_type;
+    ffStringArrayInit(&discovery->dirs, 0);
+    ffStringArrayInit(&discovery->fonts, 0);
+    font_index_init(&discovery->index);
+    ffGetPlatformFontDirs(&discovery->dirs);
+    discovery->thread = check_ptr(SDL_CreateThread(font_discovery_thread, "font_discovery", discovery), "Couldn't create a SDL thread", SDL_GetError());
 }
 
-typedef struct {
-    size_t window_width;
-    size_t window_height;
-    size_t window_position_x;
-    size_t window_position_y;
-} WindowParams;
+// Stop the search if it is still running and free everything.
+void font_discovery_finish(FontDiscovery* discovery) {
+    SDL_AtomicSet(&discovery->should_stop, 1);
+    SDL_WaitThread(discovery->thread, NULL);
+    font_index_destroy(&discovery->index);
+    ffStringArrayDestroy(&discovery->fonts);
+    ffStringArrayDestroy(&discovery->dirs);
+    SDL_DestroyMutex(discovery->mutex);
+}
 
 typedef struct {
-    FF_StringArray* ff_struct_ptr;
+    FontDiscovery* font_discovery;
     WindowParams* window_params;
     TTF_Font* font_ptr;
+    int font_size;
+    RendererPreference renderer_preference;
     char font_path[MAX_STRING_LENGTH_CAPACITY];
 } PopupArgs;
 
+// What the font popup shows: the font families indexed so far (their names
+// copied out of the FontDiscovery so drawing doesn't hold its lock), narrowed
+// down by what was typed. Rows are drawn through the text texture cache, so
+// scrolling only rasterizes the rows that come into view.
+typedef struct {
+    FF_StringArray families; // by SI_Index id, which is also the FontIndex family id
+    size_t fonts_found;
+    size_t fonts_indexed;
+    bool walked;
+    SI_Index index;
+    SI_Filter filter;
+    char query[SI_MAX_QUERY];
+    size_t selected; // position in filter.ids
+    size_t top;      // first visible position
+} FontPicker;
+
+void font_picker_init(FontPicker* picker) {
+    memset(picker, 0, sizeof(*picker));
+    ffStringArrayInit(&picker->families, 0);
+    siInit(&picker->index);
+    siFilterInit(&picker->filter);
+}
+
+void font_picker_destroy(FontPicker* picker) {
+    siFilterDestroy(&picker->filter);
+    siDestroy(&picker->index);
+    ffStringArrayDestroy(&picker->families);
+}
+
+// Take in the families indexed since the last call. Returns whether the discovery is done.
+bool font_picker_sync(FontPicker* picker, FontDiscovery* discovery) {
+    SDL_LockMutex(discovery->mutex);
+    for (size_t i = picker->families.size; i < discovery->index.family_count; i++) {
+        ffStringArrayAppend(&picker->families, discovery->index.families[i].name);
+        siAdd(&picker->index, discovery->index.families[i].name);
+    }
+    picker->fonts_found = discovery->fonts.size;
+    picker->fonts_indexed = discovery->indexed_count;
+    picker->walked = discovery->walked;
+    bool done = discovery->done;
+    SDL_UnlockMutex(discovery->mutex);
+
+    siFilterUpdate(&picker->filter, &picker->index);
+    return done;
+}
+
+void font_picker_set_query(FontPicker* picker, const char* query) {
+    snprintf(picker->query, sizeof(picker->query), "%s", query);
+    siFilterSetQuery(&picker->filter, &picker->index, picker->query);
+    picker->selected = 0;
+    picker->top = 0;
+}
+
+// Move the selection by delta rows, scrolling just enough to keep it in view.
+void font_picker_move(FontPicker* picker, long delta, size_t visible_rows) {
+    size_t count = picker->filter.count;
+    if (count == 0) {
+        picker->selected = picker->top = 0;
+        return;
+    }
+    long selected = (long)picker->selected + delta;
+    picker->selected = selected < 0 ? 0 : ((size_t)selected >= count ? count - 1 : (size_t)selected);
+
+    if (visible_rows == 0) {
+        visible_rows = 1;
+    }
+    if (picker->selected < picker->top) {
+        picker->top = picker->selected;
+    } else if (picker->selected >= picker->top + visible_rows) {
+        picker->top = picker->selected - visible_rows + 1;
+    }
+}
+
+// The file of the selected family's regular face. Returns false when nothing is selected.
+bool font_picker_selected_font(FontPicker* picker, FontDiscovery* discovery, char* font_path, size_t font_path_capacity) {
+    if (picker->selected >= picker->filter.count) {
+        return false;
+    }
+    SDL_LockMutex(discovery->mutex);
+    const FontFamily* family = &discovery->index.families[picker->filter.ids[picker->selected]];
+    snprintf(font_path, font_path_capacity, "%s", discovery->index.faces[family->regular_face].path);
+    SDL_UnlockMutex(discovery->mutex);
+    return true;
+}
+
+// Drop the last UTF-8 character of the query.
+void font_picker_backspace(FontPicker* picker) {
+    char query[SI_MAX_QUERY];
+    snprintf(query, sizeof(query), "%s", picker->query);
+    size_t length = strlen(query);
+    while (length > 0 && (query[length - 1] & 0xC0) == 0x80) { // continuation bytes
+        length--;
+    }
+    if (length > 0) {
+        length--;
+    }
+    query[length] = '\0';
+    font_picker_set_query(picker, query);
+}
+
 int sdl_popup_menu(void* args) {
     PopupArgs* pargs = (PopupArgs*)args;
 
@@ -556,19 +2359,41 @@ int sdl_popup_menu(void* args) {
 
     SDL_Window* window_ptr = check_ptr(SDL_CreateWindow(popup_window_title, popup_window_position_x, popup_window_position_y, popup_window_width, popup_window_height, popup_window_sdl_flags), "Couldn't create a SDL window", SDL_GetError());
 
-    SDL_RendererFlags sdl_renderer_flags = SDL_RENDERER_SOFTWARE;
-    SDL_Renderer* renderer_ptr = check_ptr(SDL_CreateRenderer(window_ptr, -1, sdl_renderer_flags), "Couldn't create an SDL renderer", SDL_GetError());
+    SDL_Renderer* renderer_ptr = create_renderer(window_ptr, pargs->renderer_preference);
+
+    TextTextureCache text_texture_cache;
+    text_texture_cache_init(&text_texture_cache, renderer_ptr, DEFAULT_TEXTURE_CACHE_BUDGET_MB * 1024 * 1024);
+
+    FontPicker picker;
+    font_picker_init(&picker);
+    bool font_discovery_done = font_picker_sync(&picker, pargs->font_discovery);
+
+    // the key that opened the popup also queued its text, which isn't a query
+    SDL_FlushEvent(SDL_TEXTINPUT);
+    SDL_StartTextInput();
 
     bool window_should_run = true;
-    bool window_should_render = false;
+    bool window_should_render = true;
+
+    // the first row shows the query, the fonts go below it
+    int row_height = TTF_FontHeight(pargs->font_ptr);
+    if (row_height < 1) {
+        row_height = 1;
+    }
+    size_t page_rows = ((int)popup_window_height - row_height) / row_height; // rows that are fully in view
+    if (page_rows < 1) {
+        page_rows = 1;
+    }
 
     DEBUG_SHOW_LOC("Entering Font Selection Window Loop\n");
-    int user_entry_offset = 0;
-    bool enter_pressed = false;
     while (window_should_run) {
-        int y_offset = 0;
         SDL_Event sdl_events;
-        while (SDL_PollEvent(&sdl_events)) {
+        int has_event = SDL_WaitEventTimeout(&sdl_events, -1); // sleep until there is input or more fonts
+        while (has_event) {
+            if (sdl_events.type == pargs->font_discovery->fonts_found_event_type) {
+                font_discovery_done = font_picker_sync(&picker, pargs->font_discovery);
+                window_should_render = true;
+            }
             switch (sdl_events.type) {
                 case SDL_QUIT: {
                     window_should_run = false;
@@ -581,69 +2406,117 @@ int sdl_popup_menu(void* args) {
                     }
                     break;
                 }
+                case SDL_TEXTINPUT: {
+                    char query[SI_MAX_QUERY];
+                    snprintf(query, sizeof(query), "%s%s", picker.query, sdl_events.text.text);
+                    font_picker_set_query(&picker, query);
+                    window_should_render = true;
+                    break;
+                }
+                case SDL_MOUSEWHEEL: {
+                    font_picker_move(&picker, -(long)sdl_events.wheel.y * FONT_PICKER_WHEEL_ROWS, page_rows);
+                    window_should_render = true;
+                    break;
+                }
                 case SDL_KEYDOWN: {
                     window_should_render = true;
                     switch (sdl_events.key.keysym.sym) {
                         case SDLK_ESCAPE: {
-                            window_should_run = false;
+                            if (picker.query[0] != '\0') { // first clear the filter, then close
+                                font_picker_set_query(&picker, "");
+                            } else {
+                                window_should_run = false;
+                            }
+                            break;
+                        }
+                        case SDLK_BACKSPACE: {
+                            font_picker_backspace(&picker);
                             break;
                         }
                         case SDLK_UP: {
-                            user_entry_offset -= 1;
+                            font_picker_move(&picker, -1, page_rows);
                             break;
                         }
                         case SDLK_DOWN: {
-                            user_entry_offset += 1;
+                            font_picker_move(&picker, 1, page_rows);
+                            break;
+                        }
+                        case SDLK_PAGEUP: {
+                            font_picker_move(&picker, -(long)page_rows, page_rows);
+                            break;
+                        }
+                        case SDLK_PAGEDOWN: {
+                            font_picker_move(&picker, (long)page_rows, page_rows);
+                            break;
+                        }
+                        case SDLK_HOME: {
+                            font_picker_move(&picker, -(long)picker.selected, page_rows);
+                            break;
+                        }
+                        case SDLK_END: {
+                            font_picker_move(&picker, (long)picker.filter.count, page_rows);
                             break;
                         }
                         case SDLK_RETURN: {
-                            enter_pressed = true;
+                            if (font_picker_selected_font(&picker, pargs->font_discovery, pargs->font_path, MAX_STRING_LENGTH_CAPACITY)) {
+                                window_should_run = false; // nothing to pick yet otherwise
+                            }
                             break;
                         }
                     }
                 }
             }
+            has_event = SDL_PollEvent(&sdl_events);
         }
 
-        if (window_should_render) {
+        if (window_should_run && window_should_render) {
 
             SDL_SetRenderDrawColor(renderer_ptr, 255, 255, 255, 255);
             SDL_RenderClear(renderer_ptr);
 
-            for (size_t i = 0; i < pargs->ff_struct_ptr->size; i++) {
-
-                size_t user_adjusted_idx = calculate_user_entry_offset(i, user_entry_offset, pargs->ff_struct_ptr->size);
-                char* font_name_string = pargs->ff_struct_ptr->items[user_adjusted_idx];
+            SDL_Color text_color = {0, 0, 0, 0};
+            SDL_Color text_color_selected = {255, 255, 255, 255};
+            SDL_Color background_color_selected = {0, 0, 0, 0};
+            SDL_Color query_background_color = {224, 224, 224, 255};
 
-                if (enter_pressed) {
-                    snprintf(pargs->font_path, MAX_STRING_LENGTH_CAPACITY, "%s", font_name_string);
-                    SDL_DestroyRenderer(renderer_ptr);
-                    SDL_DestroyWindow(window_ptr);
-                    return 0;
+            char query_line[MAX_STRING_LENGTH_CAPACITY];
+            snprintf(query_line, sizeof(query_line), "> %s_   (%zu / %zu)", picker.query, picker.filter.count, picker.families.size);
+            int y_offset = 0;
+            render_text_line(&text_texture_cache, pargs->font_ptr, pargs->font_size, query_line, text_color, &query_background_color, &y_offset, 1.0);
+
+            // only the rows in view are drawn, whatever the number of fonts
+            size_t row_count = visible_row_count((int)popup_window_height - y_offset, row_height, picker.filter.count - picker.top);
+            for (size_t row = 0; row < row_count; row++) {
+                size_t position = picker.top + row;
+                const char* font_name_string = picker.families.items[picker.filter.ids[position]];
+                if (font_name_string[0] == '\0') {
+                    continue;
                 }
-
-                SDL_Color text_color = {0, 0, 0, 0};
-                SDL_Color text_color_selected = {255, 255, 255, 255};
-                SDL_Color background_color_selected = {0, 0, 0, 0};
-                SDL_Surface* text_surface;
-
-                if (i < 1) { // first item should be highlighted
-                    text_surface = check_ptr(TTF_RenderText_Shaded(pargs->font_ptr, font_name_string, text_color_selected, background_color_selected), "Error loading a font text surface", TTF_GetError());
+                if (position == picker.selected) {
+                    render_text_line(&text_texture_cache, pargs->font_ptr, pargs->font_size, font_name_string, text_color_selected, &background_color_selected, &y_offset, 1.0);
                 } else {
-                    text_surface = check_ptr(TTF_RenderText_Blended(pargs->font_ptr, font_name_string, text_color), "Error loading a font text surface", TTF_GetError());
+                    render_text_line(&text_texture_cache, pargs->font_ptr, pargs->font_size, font_name_string, text_color, NULL, &y_offset, 1.0);
                 }
+            }
 
-                render_text_line(renderer_ptr, text_surface, &y_offset, 1.0);
-
-                if ((size_t)(y_offset) > popup_window_height) { // don't render the rest of the lines
-                    break;
+            if (!font_discovery_done) {
+                char status_line[MAX_STRING_LENGTH_CAPACITY];
+                if (picker.walked) {
+                    snprintf(status_line, sizeof(status_line), "Reading font names... %zu / %zu", picker.fonts_indexed, picker.fonts_found);
+                } else {
+                    snprintf(status_line, sizeof(status_line), "Searching for fonts... %zu found", picker.fonts_found);
                 }
+                SDL_Color status_background_color = {64, 64, 64, 255};
+                render_status_badge(&text_texture_cache, pargs->font_ptr, pargs->font_size, status_line, status_background_color, 1.0);
             }
+
             SDL_RenderPresent(renderer_ptr);
             window_should_render = false;
         }
-        SDL_Delay(SDL_DELAY_FACTOR / 8);
     }
+    SDL_StopTextInput();
+    font_picker_destroy(&picker);
+    text_texture_cache_destroy(&text_texture_cache);
     SDL_DestroyRenderer(renderer_ptr);
     SDL_DestroyWindow(window_ptr);
     return 0;
@@ -652,9 +2525,21 @@ int sdl_popup_menu(void* args) {
 void interpret_sdl_events(SDL_Window* window_ptr, SDL_bool* window_is_resizable, SDL_bool* window_is_bordered, SDL_bool* window_is_on_top,
                           bool* window_should_render, bool* window_should_run, int* window_position_x, int* window_position_y,
                           int* window_width, int* window_height, float* zoom_scale, int* user_entry_offset,
-                          bool* config_file_should_be_read, SDL_Color* bg_color, char* font_path, TTF_Font** font_ptr_ptr, int* font_size_ptr) {
+                          bool* config_file_should_be_read, SDL_Color* bg_color, char* font_path, TTF_Font** font_ptr_ptr, int* font_size_ptr,
+                          TextTextureCache* text_texture_cache, RendererPreference renderer_preference, int wait_timeout_ms, Uint32 file_watch_event_type, bool* watched_files_changed,
+                          Uint32 scan_done_event_type, bool* scan_results_ready, Uint32 fonts_found_event_type, WorkerPool* font_pool, Uint32 font_resolved_event_type, bool* font_resolved,
+                          bool* perf_hud_visible) {
     SDL_Event sdl_events;
-    while (SDL_PollEvent(&sdl_events)) {
+    // block until something happens (or wait_timeout_ms passes), then drain the queue
+    int has_event = SDL_WaitEventTimeout(&sdl_events, wait_timeout_ms);
+    while (has_event) {
+        if (sdl_events.type == file_watch_event_type) {
+            *watched_files_changed = true;
+        } else if (sdl_events.type == scan_done_event_type) {
+            *scan_results_ready = true;
+        } else if (sdl_events.type == font_resolved_event_type) {
+            *font_resolved = true;
+        }
         switch (sdl_events.type) {
             case SDL_QUIT: {
                 *window_should_run = false;
@@ -721,6 +2606,10 @@ void interpret_sdl_events(SDL_Window* window_ptr, SDL_bool* window_is_resizable,
                             *config_file_should_be_read = true;
                             break;
                         }
+                        case SDLK_F12: {
+                            *perf_hud_visible = !*perf_hud_visible;
+                            break;
+                        }
                         case SDLK_r: {
                             bg_color->r += COLOR_CHANGE_FACTOR;
                             break;
@@ -777,14 +2666,9 @@ void interpret_sdl_events(SDL_Window* window_ptr, SDL_bool* window_is_resizable,
                         }
                         case SDLK_f: {
 
-                            FF_StringArray ff_struct;
-                            FF_StringArray dirs;
-
-                            ffStringArrayInit(&ff_struct, 0);
-                            ffStringArrayInit(&dirs, 0);
-
-                            ffGetPlatformFontDirs(&dirs);
-                            ffFindFonts(&dirs, &ff_struct);
+                            // the popup opens right away and fills up as fonts are found
+                            FontDiscovery font_discovery;
+                            font_discovery_start(&font_discovery, fonts_found_event_type, font_pool);
 
                             WindowParams window_params;
                             window_params.window_width = *window_width;
@@ -793,16 +2677,19 @@ void interpret_sdl_events(SDL_Window* window_ptr, SDL_bool* window_is_resizable,
                             window_params.window_position_y = *window_position_y;
 
                             PopupArgs* popup_args = malloc(sizeof *popup_args);
-                            popup_args->ff_struct_ptr = &ff_struct;
+                            popup_args->font_discovery = &font_discovery;
                             popup_args->window_params = &window_params;
                             snprintf(popup_args->font_path, MAX_STRING_LENGTH_CAPACITY, "%s", font_path);
                             popup_args->font_ptr = *font_ptr_ptr;
+                            popup_args->font_size = *font_size_ptr;
+                            popup_args->renderer_preference = renderer_preference;
 
                             sdl_popup_menu(popup_args);
 
                             if (!(strcmp(popup_args->font_path, font_path) == 0)) {
                                 snprintf(font_path, MAX_STRING_LENGTH_CAPACITY, "%s", popup_args->font_path);
                                 DEBUG_SHOW_LOC("\nloading font \"%s\"\n", font_path);
+                                text_texture_cache_forget_font(text_texture_cache, *font_ptr_ptr);
                                 TTF_CloseFont(*font_ptr_ptr);
                                 *font_ptr_ptr = check_ptr(TTF_OpenFont(font_path, *font_size_ptr), "Error loading font", TTF_GetError());
                                 DEBUG_PRINTF("font is now  \"%s\" (font_ptr set!)\n", font_path);
@@ -810,14 +2697,19 @@ void interpret_sdl_events(SDL_Window* window_ptr, SDL_bool* window_is_resizable,
 
                             free(popup_args);
 
-                            ffStringArrayDestroy(&ff_struct);
-                            ffStringArrayDestroy(&dirs);
+                            // the popup's own loop swallowed any file watch, scan and font events
+                            *watched_files_changed = true;
+                            *scan_results_ready = true;
+                            *font_resolved = true;
+
+                            font_discovery_finish(&font_discovery);
                             break;
                         }
                     }
                 }
             }
         }
+        has_event = SDL_PollEvent(&sdl_events);
     }
 }
 
@@ -825,38 +2717,51 @@ int main(int argc __attribute__((unused)), char* argv[] __attribute__((unused)))
 
     char* keywords_array[MAX_KEYWORDS];
     char* target_paths_array[MAX_TARGET_PATHS];
-    bool target_path_nonexistence_array[MAX_TARGET_PATHS];
-    char* conf_file_lines_array[MAX_LINES_IN_CONFIG_FILE];
-    char* matching_lines_array[MAX_MATCHING_LINES_CAPACITY];
+    CF_Config config;
+    CF_Config previous_config; // the one before the last reload, to diff against
     char* window_height_array[SINGLE_CONFIG_VALUE_SIZE];
     char* window_width_array[SINGLE_CONFIG_VALUE_SIZE];
     char* window_x_position_array[SINGLE_CONFIG_VALUE_SIZE];
     char* window_y_position_array[SINGLE_CONFIG_VALUE_SIZE];
     char* first_entry_only_array[SINGLE_CONFIG_VALUE_SIZE];
     char* trim_out_keywords_array[SINGLE_CONFIG_VALUE_SIZE];
+    char* mmap_targets_array[SINGLE_CONFIG_VALUE_SIZE];
+    char* texture_cache_budget_array[SINGLE_CONFIG_VALUE_SIZE];
+    char* renderer_array[SINGLE_CONFIG_VALUE_SIZE];
+    char* font_family_array[SINGLE_CONFIG_VALUE_SIZE];
     char conf_file_path[MAX_STRING_LENGTH_CAPACITY];
     size_t keywords_count;
     size_t target_paths_count;
-    size_t conf_file_line_count;
-    size_t matching_lines_curr_line_index;
     size_t window_height_count;
     size_t window_width_count;
     size_t window_x_position_count;
     size_t window_y_position_count;
     size_t first_entry_only_count;
     size_t trim_out_keywords_count;
+    size_t mmap_targets_count;
+    size_t texture_cache_budget_count;
+    size_t renderer_count;
+    size_t font_family_count;
     SDL_Color bg_color = {24, 128, 64, 240};
 
     initialize_string_array(keywords_array, MAX_KEYWORDS, MAX_STRING_LENGTH_CAPACITY);
     initialize_string_array(target_paths_array, MAX_TARGET_PATHS, MAX_STRING_LENGTH_CAPACITY);
-    initialize_string_array(conf_file_lines_array, MAX_LINES_IN_CONFIG_FILE, MAX_STRING_LENGTH_CAPACITY);
-    initialize_string_array(matching_lines_array, MAX_MATCHING_LINES_CAPACITY, MAX_STRING_LENGTH_CAPACITY);
+    cfInit(&config);
+    cfInit(&previous_config);
     initialize_string_array(window_height_array, SINGLE_CONFIG_VALUE_SIZE, MAX_STRING_LENGTH_CAPACITY);
     initialize_string_array(window_width_array, SINGLE_CONFIG_VALUE_SIZE, MAX_STRING_LENGTH_CAPACITY);
     initialize_string_array(window_x_position_array, SINGLE_CONFIG_VALUE_SIZE, MAX_STRING_LENGTH_CAPACITY);
     initialize_string_array(window_y_position_array, SINGLE_CONFIG_VALUE_SIZE, MAX_STRING_LENGTH_CAPACITY);
     initialize_string_array(first_entry_only_array, SINGLE_CONFIG_VALUE_SIZE, MAX_STRING_LENGTH_CAPACITY);
     initialize_string_array(trim_out_keywords_array, SINGLE_CONFIG_VALUE_SIZE, MAX_STRING_LENGTH_CAPACITY);
+    initialize_string_array(mmap_targets_array, SINGLE_CONFIG_VALUE_SIZE, MAX_STRING_LENGTH_CAPACITY);
+    initialize_string_array(texture_cache_budget_array, SINGLE_CONFIG_VALUE_SIZE, MAX_STRING_LENGTH_CAPACITY);
+    initialize_string_array(renderer_array, SINGLE_CONFIG_VALUE_SIZE, MAX_STRING_LENGTH_CAPACITY);
+    initialize_string_array(font_family_array, SINGLE_CONFIG_VALUE_SIZE, MAX_STRING_LENGTH_CAPACITY);
+
+    if (trInit(getenv(TRACE_ENV_VAR))) {
+        trSetThreadName("main");
+    }
 
     const char* window_title = "WhatWasiDoing";
     const char* conf_file_filename = CONFIG_FILE_NAME;
@@ -871,45 +2776,26 @@ int main(int argc __attribute__((unused)), char* argv[] __attribute__((unused)))
     snprintf(conf_file_path, sizeof(conf_file_path), "%s/%s", user_env_home, conf_file_filename);
 #endif
 
-    conf_file_line_count = conf_file_lines_into_array(conf_file_path, conf_file_lines_array, conf_file_filename);
+    load_config_file(conf_file_path, &config, conf_file_filename);
 
-    target_paths_count = extract_config_values("file", target_paths_array, MAX_TARGET_PATHS, conf_file_lines_array, conf_file_line_count);
-    keywords_count = extract_config_values("keyword", keywords_array, MAX_KEYWORDS, conf_file_lines_array, conf_file_line_count);
-    first_entry_only_count = extract_config_values("first_entry_only", first_entry_only_array, SINGLE_CONFIG_VALUE_SIZE, conf_file_lines_array, conf_file_line_count);
-    trim_out_keywords_count = extract_config_values("trim_out_keywords", trim_out_keywords_array, SINGLE_CONFIG_VALUE_SIZE, conf_file_lines_array, conf_file_line_count);
+    target_paths_count = extract_config_values("file", target_paths_array, MAX_TARGET_PATHS, &config);
+    keywords_count = extract_config_values("keyword", keywords_array, MAX_KEYWORDS, &config);
+    first_entry_only_count = extract_config_values("first_entry_only", first_entry_only_array, SINGLE_CONFIG_VALUE_SIZE, &config);
+    trim_out_keywords_count = extract_config_values("trim_out_keywords", trim_out_keywords_array, SINGLE_CONFIG_VALUE_SIZE, &config);
+    mmap_targets_count = extract_config_values("mmap_targets", mmap_targets_array, SINGLE_CONFIG_VALUE_SIZE, &config);
+    texture_cache_budget_count = extract_config_values("texture_cache_budget_mb", texture_cache_budget_array, SINGLE_CONFIG_VALUE_SIZE, &config);
+    renderer_count = extract_config_values("renderer", renderer_array, SINGLE_CONFIG_VALUE_SIZE, &config);
+    font_family_count = extract_config_values("font_family", font_family_array, SINGLE_CONFIG_VALUE_SIZE, &config);
 
-    window_x_position_count = extract_config_values("initial_window_x", window_x_position_array, SINGLE_CONFIG_VALUE_SIZE, conf_file_lines_array, conf_file_line_count);
-    window_y_position_count = extract_config_values("initial_window_y", window_y_position_array, SINGLE_CONFIG_VALUE_SIZE, conf_file_lines_array, conf_file_line_count);
-    window_width_count = extract_config_values("initial_window_width", window_width_array, SINGLE_CONFIG_VALUE_SIZE, conf_file_lines_array, conf_file_line_count);
-    window_height_count = extract_config_values("initial_window_height", window_height_array, SINGLE_CONFIG_VALUE_SIZE, conf_file_lines_array, conf_file_line_count);
+    window_x_position_count = extract_config_values("initial_window_x", window_x_position_array, SINGLE_CONFIG_VALUE_SIZE, &config);
+    window_y_position_count = extract_config_values("initial_window_y", window_y_position_array, SINGLE_CONFIG_VALUE_SIZE, &config);
+    window_width_count = extract_config_values("initial_window_width", window_width_array, SINGLE_CONFIG_VALUE_SIZE, &config);
+    window_height_count = extract_config_values("initial_window_height", window_height_array, SINGLE_CONFIG_VALUE_SIZE, &config);
 
-    matching_lines_curr_line_index = 0;
-    bool conf_file_existence = true;
-    time_t conf_file_last_mtime = 0;
-    {
-        struct stat file_stat;
-        check_code(stat(conf_file_path, &file_stat), "File modification check failed.");
-        if (file_stat.st_mtime > conf_file_last_mtime) {
-            conf_file_last_mtime = file_stat.st_mtime;
-        }
-    }
-    time_t target_paths_last_mtime = 0;
-    // use target_paths_modified to update "the existence array" and "the last modification time"
-    if (target_paths_modified(target_paths_array, target_paths_count, &target_paths_last_mtime, target_path_nonexistence_array) != 0) {
-        DEBUG_SHOW_LOC("Read target paths from config file, and keyword lines from the target paths.\n");
-        for (size_t i = 0; i < target_paths_count; i++) {
-            DEBUG_PRINTF(YEL "%zu: %s " RESET "\n", i + 1, target_paths_array[i]);
-            keyword_lines_into_array(target_paths_array[i], matching_lines_array, &matching_lines_curr_line_index, MAX_MATCHING_LINES_CAPACITY, keywords_array, keywords_count);
-
-            if (i > 0) { // check if there are files in the first place
-                struct stat target_path_file_stat;
-                check_code(stat(target_paths_array[i], &target_path_file_stat), "File modification check failed.");
-                if (target_path_file_stat.st_mtime > target_paths_last_mtime) {
-                    target_paths_last_mtime = target_path_file_stat.st_mtime;
-                }
-            }
-        }
-    }
+    FW_Watcher watcher;
+    fwInit(&watcher);
+    size_t conf_file_watch_id = watch_config_and_targets(&watcher, conf_file_path, target_paths_array, target_paths_count);
+    DEBUG_SHOW_LOC("Watching files %s\n", fwIsPolling(&watcher) ? "(stat polling)" : "(inotify)");
 
     // SDL /////////////////////////////////////////////////////////
     DEBUG_SHOW_LOC("Initializing SDL_ttf\n");
@@ -923,12 +2809,58 @@ int main(int argc __attribute__((unused)), char* argv[] __attribute__((unused)))
 #else
     char font_path[MAX_STRING_LENGTH_CAPACITY] = "/usr/share/fonts/adobe-source-code-pro/SourceCodePro-Regular.otf";
 #endif
+    // reads the name tables of the installed fonts, for font_family and the font popup
+    WorkerPool font_pool;
+    worker_pool_init(&font_pool);
+    // the first frame is drawn with the default font while font_family is looked
+    // up in the background, unless there is no default font to draw it with
+    bool font_family_resolved = false;
+    if (font_family_count > 0 && !file_exists(font_path)) {
+        // only the file that gets picked is opened, the others just have their name table read
+        if (!resolve_font_family(font_family_array[0], font_path, sizeof(font_path), &font_pool, NULL)) {
+            fprintf(stderr, "No installed font has the family \"%s\", using %s\n", font_family_array[0], font_path);
+        }
+        font_family_resolved = true;
+    }
     int font_size = 36;
     TTF_Font* font_ptr = check_ptr(TTF_OpenFont(font_path, font_size), "Error loading font", TTF_GetError());
 
     DEBUG_SHOW_LOC("Initializing SDL\n");
     check_code(SDL_Init(SDL_INIT_VIDEO), SDL_GetError());
 
+    // file_watch_event_type, scan_done_event_type, fonts_found_event_type and font_resolved_event_type
+    Uint32 user_event_base = SDL_RegisterEvents(4);
+    if (user_event_base == (Uint32)-1) {
+        check_code(-1, SDL_GetError());
+    }
+    Uint32 file_watch_event_type = user_event_base;
+    Uint32 scan_done_event_type = user_event_base + 1;
+    Uint32 fonts_found_event_type = user_event_base + 2;
+    Uint32 font_resolved_event_type = user_event_base + 3;
+    FontResolver font_resolver;
+    font_resolver_start(&font_resolver, font_resolved_event_type, &font_pool);
+    if (font_family_count > 0 && !font_family_resolved) {
+        font_resolver_request(&font_resolver, font_family_array[0]);
+    }
+
+    const bool default_mmap_targets = false;
+    bool mmap_targets_setting = parse_single_user_value_bool(mmap_targets_array, mmap_targets_count, default_mmap_targets);
+    Diagnostics diagnostics;
+    diagnostics_init(&diagnostics);
+    report_config_errors(&config, conf_file_path, &diagnostics);
+    Metrics metrics;
+    metrics_init(&metrics);
+    MetricsServer metrics_server;
+    bool metrics_served = metrics_server_start(&metrics_server, &metrics);
+    ScanThread scan_thread;
+    EntrySnapshot* entry_snapshot;
+    scan_thread_start(&scan_thread, scan_done_event_type, &diagnostics, &metrics, &entry_snapshot);
+    DEBUG_SHOW_LOC("Read target paths from config file, and keyword lines from the target paths.\n");
+    for (size_t i = 0; i < target_paths_count; i++) {
+        DEBUG_PRINTF(YEL "%zu: %s " RESET "\n", i + 1, target_paths_array[i]);
+    }
+    scan_thread_request_reconfigure(&scan_thread, target_paths_array, target_paths_count, keywords_array, keywords_count, mmap_targets_setting, true);
+
     int user_display_index = 0;
     SDL_DisplayMode user_display_mode_info;
     SDL_GetDesktopDisplayMode(user_display_index, &user_display_mode_info);
@@ -958,20 +2890,39 @@ int main(int argc __attribute__((unused)), char* argv[] __attribute__((unused)))
     SDL_bool window_is_resizable = SDL_FALSE;
     SDL_bool window_is_on_top = SDL_TRUE;
 
-    SDL_RendererFlags sdl_renderer_flags = SDL_RENDERER_SOFTWARE;
-    SDL_Renderer* renderer_ptr = check_ptr(SDL_CreateRenderer(window_ptr, -1, sdl_renderer_flags), "Couldn't create an SDL renderer", SDL_GetError());
+    RendererPreference renderer_preference = parse_renderer_preference(renderer_array, renderer_count);
+    SDL_Renderer* renderer_ptr = create_renderer(window_ptr, renderer_preference);
+
+    int texture_cache_budget_mb = parse_single_user_value_int(texture_cache_budget_array, texture_cache_budget_count, DEFAULT_TEXTURE_CACHE_BUDGET_MB);
+    TextTextureCache text_texture_cache;
+    text_texture_cache_init(&text_texture_cache, renderer_ptr, (size_t)SDL_max(texture_cache_budget_mb, 0) * 1024 * 1024);
 
     DEBUG_SHOW_LOC("Entering SDL Event Loop\n");
     int user_entry_offset = 0;
     bool window_should_run = true;
     bool window_should_render = true;
     bool config_file_should_be_read = false;
-    while (window_should_run) {
-        interpret_sdl_events(window_ptr, &window_is_resizable, &window_is_bordered, &window_is_on_top, &window_should_render,
-                             &window_should_run, &window_position_x, &window_position_y, &window_width, &window_height,
-                             &zoom_scale, &user_entry_offset, &config_file_should_be_read, &bg_color, font_path, &font_ptr, &font_size);
+    bool watched_files_changed = false;
+    bool scan_results_ready = false;
+    bool font_resolved = false;
+    PerfHud perf_hud;
+    memset(&perf_hud, 0, sizeof(perf_hud));
+    char* entry_text_buffer = NULL; // reused for every drawn entry
+    FILE* present_log = open_present_log();
+    size_t entry_text_buffer_capacity = 0;
+
+    FileWatchThreadArgs file_watch_args;
+    file_watch_args.watcher = &watcher;
+    file_watch_args.watcher_mutex = check_ptr(SDL_CreateMutex(), "Couldn't create a SDL mutex", SDL_GetError());
+    file_watch_args.file_watch_event_type = file_watch_event_type;
+    SDL_AtomicSet(&file_watch_args.should_run, 1);
+    SDL_Thread* file_watch_thread_ptr = check_ptr(SDL_CreateThread(file_watch_thread, "file_watch", &file_watch_args), "Couldn't create a SDL thread", SDL_GetError());
 
+    while (window_should_run) {
         if (window_should_render) {
+            Uint64 frame_started = SDL_GetPerformanceCounter();
+            uint64_t frame_traced = trBegin();
+            size_t frame_misses_before = text_texture_cache.misses;
             SDL_SetRenderDrawColor(renderer_ptr, bg_color.r, bg_color.g, bg_color.b, bg_color.a);
             DEBUG_SHOW_LOC("BG Colors:\n"
                            "\tr = %u\n"
@@ -983,108 +2934,268 @@ int main(int argc __attribute__((unused)), char* argv[] __attribute__((unused)))
 
             int y_offset = 0;
 
-            // when no entries are found, show "NONE"
-            if (matching_lines_curr_line_index == 0) {
+            size_t matching_lines_curr_line_index = entry_snapshot->entry_count;
+
+            // until the first scan is done show "...", when no entries are found, show "NONE"
+            if (!entry_snapshot->complete) {
+                SDL_Color text_color = {255, 255, 255, 255};
+
+                render_text_line(&text_texture_cache, font_ptr, font_size, "...", text_color, NULL, &y_offset, zoom_scale);
+            } else if (matching_lines_curr_line_index == 0) {
                 const char* text_as_none = "NONE";
                 SDL_Color text_color = {255, 255, 255, 255};
-                SDL_Surface* text_surface = TTF_RenderText_Blended(font_ptr, text_as_none, text_color);
 
-                render_text_line(renderer_ptr, text_surface, &y_offset, zoom_scale);
+                render_text_line(&text_texture_cache, font_ptr, font_size, text_as_none, text_color, NULL, &y_offset, zoom_scale);
             } else if (first_entry_only_setting) {
                 // show only first entry
                 for (size_t i = 0; i < 1; i++) {
 
                     SDL_Color text_color = {255, 255, 255, 255};
-                    SDL_Surface* text_surface;
-                    size_t matching_lines_array_user_adjusted_idx = calculate_user_entry_offset(i, user_entry_offset, matching_lines_curr_line_index);
+                    const char* entry_text;
+                    const SC_MatchSpan* entry = entry_snapshot->entries[calculate_user_entry_offset(i, user_entry_offset, matching_lines_curr_line_index)];
 
                     if (i == 0) {
-                        char matching_lines_first_line_text[MAX_STRING_LENGTH_CAPACITY];
                         const char* matching_lines_first_line_prefix = "Current Task: ";
 
                         // trim out item prefixes and keywords
-                        for (size_t j = 0; j < keywords_count; j++) {
-                            trim_keyword_prefix(matching_lines_array[matching_lines_array_user_adjusted_idx], keywords_array[j]);
-                        }
-                        snprintf(matching_lines_first_line_text, sizeof(matching_lines_first_line_text), "%s%s", matching_lines_first_line_prefix, matching_lines_array[matching_lines_array_user_adjusted_idx]);
-                        text_surface = check_ptr(TTF_RenderText_Blended(font_ptr, matching_lines_first_line_text, text_color), "Error loading a font text surface", TTF_GetError());
+                        entry_text = entry_display_text(entry, matching_lines_first_line_prefix, entry_snapshot->keywords[entry->keyword_id], &entry_text_buffer, &entry_text_buffer_capacity);
                     } else {
-                        text_surface = check_ptr(TTF_RenderText_Blended(font_ptr, matching_lines_array[matching_lines_array_user_adjusted_idx], text_color), "Error loading a font text surface", TTF_GetError());
+                        entry_text = entry_display_text(entry, "", NULL, &entry_text_buffer, &entry_text_buffer_capacity);
                     }
 
-                    render_text_line(renderer_ptr, text_surface, &y_offset, zoom_scale);
+                    render_text_line(&text_texture_cache, font_ptr, font_size, entry_text, text_color, NULL, &y_offset, zoom_scale);
                 }
-            } else { // iterate over all of them
-                for (size_t i = 0; i < matching_lines_curr_line_index; i++) {
+            } else { // iterate over the ones that fit in the window
+                int viewport_width, viewport_height;
+                SDL_GetRendererOutputSize(renderer_ptr, &viewport_width, &viewport_height);
+                size_t visible_entry_count = visible_row_count(viewport_height, TTF_FontHeight(font_ptr) * zoom_scale, matching_lines_curr_line_index);
+
+                for (size_t i = 0; i < visible_entry_count && y_offset < viewport_height; i++) {
 
                     SDL_Color text_color = {255, 255, 255, 255};
-                    SDL_Surface* text_surface;
-                    size_t matching_lines_array_user_adjusted_idx = calculate_user_entry_offset(i, user_entry_offset, matching_lines_curr_line_index);
+                    const SC_MatchSpan* entry = entry_snapshot->entries[calculate_user_entry_offset(i, user_entry_offset, matching_lines_curr_line_index)];
 
-                    if (trim_out_keywords_setting) {
-                        // trim out item prefixes and keywords in the current line
-                        for (size_t j = 0; j < keywords_count; j++) {
-                            trim_keyword_prefix(matching_lines_array[matching_lines_array_user_adjusted_idx], keywords_array[j]);
-                        }
-                    }
+                    // trim out item prefixes and keywords in the current line
+                    const char* keyword_to_trim = trim_out_keywords_setting ? entry_snapshot->keywords[entry->keyword_id] : NULL;
 
-                    if (i == 0) { // first shown entry should have an identifier prefix
-                        const char* matching_lines_first_line_prefix = "Current Task: ";
-                        char matching_lines_first_line_text[MAX_STRING_LENGTH_CAPACITY];
-                        snprintf(matching_lines_first_line_text, sizeof(matching_lines_first_line_text), "%s%s", matching_lines_first_line_prefix, matching_lines_array[matching_lines_array_user_adjusted_idx]);
-                        text_surface = check_ptr(TTF_RenderText_Blended(font_ptr, matching_lines_first_line_text, text_color), "Error loading a font text surface", TTF_GetError());
-                    } else {
-                        text_surface = check_ptr(TTF_RenderText_Blended(font_ptr, matching_lines_array[matching_lines_array_user_adjusted_idx], text_color), "Error loading a font text surface", TTF_GetError());
-                    }
+                    // first shown entry should have an identifier prefix
+                    const char* entry_text = entry_display_text(entry, i == 0 ? "Current Task: " : "", keyword_to_trim, &entry_text_buffer, &entry_text_buffer_capacity);
 
-                    render_text_line(renderer_ptr, text_surface, &y_offset, zoom_scale);
+                    render_text_line(&text_texture_cache, font_ptr, font_size, entry_text, text_color, NULL, &y_offset, zoom_scale);
                 }
             }
 
+            // missing files and other problems the user should know about
+            char status_line[MAX_STRING_LENGTH_CAPACITY];
+            if (diagnostics_status_line(&diagnostics, status_line, sizeof(status_line))) {
+                SDL_Color status_background_color = {160, 32, 32, 255};
+                render_status_badge(&text_texture_cache, font_ptr, font_size, status_line, status_background_color, zoom_scale);
+            }
+
+            if (perf_hud.visible) {
+                perf_hud_draw(&perf_hud, renderer_ptr, font_ptr, entry_snapshot, &text_texture_cache);
+            }
+
             SDL_RenderPresent(renderer_ptr);
+            trEnd("frame", frame_traced, NULL);
             window_should_render = false;
+            Uint64 frame_ticks = SDL_GetPerformanceCounter() - frame_started;
+            perf_hud.frame_ms = (double)frame_ticks * 1000.0 / SDL_GetPerformanceFrequency();
+            mtAdd(&metrics.frames, 1);
+            mtObserve(&metrics.render_seconds, (double)frame_ticks * 1000000000.0 / SDL_GetPerformanceFrequency());
+            mtSet(&metrics.texture_cache_bytes, text_texture_cache.bytes_used);
+            perf_hud.frame_misses = text_texture_cache.misses - frame_misses_before;
+            if (present_log) {
+                log_present(present_log, entry_snapshot->complete ? entry_snapshot->entry_count : 0);
+            }
+            DEBUG_PRINTF("Text textures: %zu cached (%zu KiB), %zu hits, %zu misses\n", text_texture_cache.live_count, text_texture_cache.bytes_used / 1024, text_texture_cache.hits, text_texture_cache.misses);
         }
-        SDL_Delay(SDL_DELAY_FACTOR);
 
-        if (path_modified(conf_file_path, &conf_file_last_mtime, &conf_file_existence, &conf_file_line_count) != 0 || config_file_should_be_read) {
-            window_should_render = true;
+        // sleeps until input arrives or the file watch thread reports a change
+        interpret_sdl_events(window_ptr, &window_is_resizable, &window_is_bordered, &window_is_on_top, &window_should_render,
+                             &window_should_run, &window_position_x, &window_position_y, &window_width, &window_height,
+                             &zoom_scale, &user_entry_offset, &config_file_should_be_read, &bg_color, font_path, &font_ptr, &font_size,
+                             &text_texture_cache, renderer_preference, perf_hud.visible ? PERF_HUD_REFRESH_MS : -1, file_watch_event_type, &watched_files_changed, scan_done_event_type,
+                             &scan_results_ready, fonts_found_event_type, &font_pool, font_resolved_event_type, &font_resolved, &perf_hud.visible);
+
+        bool conf_file_changed = false;
+        bool target_paths_changed = false;
+        bool target_path_changed_array[MAX_TARGET_PATHS] = {false};
+        if (watched_files_changed) {
+            watched_files_changed = false;
+            SDL_LockMutex(file_watch_args.watcher_mutex);
+            conf_file_changed = fwTakeChanged(&watcher, conf_file_watch_id);
+            for (size_t i = 0; i < target_paths_count; i++) {
+                target_path_changed_array[i] = fwTakeChanged(&watcher, conf_file_watch_id + 1 + i);
+            }
+            SDL_UnlockMutex(file_watch_args.watcher_mutex);
+
+            // only re-parse the files that changed, the rest come from the cache
+            for (size_t i = 0; i < target_paths_count; i++) {
+                if (target_path_changed_array[i]) {
+                    DEBUG_SHOW_LOC("Target file changed: %s\n", target_paths_array[i]);
+                    target_paths_changed = true;
+                }
+            }
+        }
+
+        // changes the watcher reported for the current target list, before a reload can replace it
+        if (target_paths_changed) {
+            scan_thread_request_changed(&scan_thread, target_path_changed_array, target_paths_count);
+        }
+
+        if (conf_file_changed || config_file_should_be_read) {
+            uint64_t reload_traced = trBegin();
+            bool reload_requested = config_file_should_be_read; // pressing c re-reads every target as well
             config_file_should_be_read = false;
-            if (conf_file_existence) {
-                conf_file_line_count = conf_file_lines_into_array(conf_file_path, conf_file_lines_array, conf_file_filename);
-                target_paths_count = extract_config_values("file", target_paths_array, MAX_TARGET_PATHS, conf_file_lines_array, conf_file_line_count);
-                keywords_count = extract_config_values("keyword", keywords_array, MAX_KEYWORDS, conf_file_lines_array, conf_file_line_count);
-                first_entry_only_count = extract_config_values("first_entry_only", first_entry_only_array, SINGLE_CONFIG_VALUE_SIZE, conf_file_lines_array, conf_file_line_count);
-                first_entry_only_setting = parse_single_user_value_bool(first_entry_only_array, first_entry_only_count, default_show_first_entry_only);
-                trim_out_keywords_count = extract_config_values("trim_out_keywords", trim_out_keywords_array, SINGLE_CONFIG_VALUE_SIZE, conf_file_lines_array, conf_file_line_count);
-                trim_out_keywords_setting = parse_single_user_value_bool(trim_out_keywords_array, trim_out_keywords_count, default_trim_out_keywords);
+
+            CF_Config swap = previous_config;
+            previous_config = config;
+            config = swap;
+            if (file_exists(conf_file_path)) {
+                load_config_file(conf_file_path, &config, conf_file_filename);
             } else {
-                conf_file_line_count = 0;
-                target_paths_count = extract_config_values("file", target_paths_array, MAX_TARGET_PATHS, conf_file_lines_array, conf_file_line_count);
-                keywords_count = extract_config_values("keyword", keywords_array, MAX_KEYWORDS, conf_file_lines_array, conf_file_line_count);
-                first_entry_only_count = extract_config_values("first_entry_only", first_entry_only_array, SINGLE_CONFIG_VALUE_SIZE, conf_file_lines_array, conf_file_line_count);
+                cfReset(&config);
+            }
+            if (report_config_errors(&config, conf_file_path, &diagnostics)) {
+                window_should_render = true;
+            }
+            ConfigDiff diff = config_diff(&previous_config, &config);
+            DEBUG_SHOW_LOC("Config changes: targets %d, keywords %d, mmap %d, geometry %d, presentation %d, texture budget %d, renderer %d, font %d\n", diff.targets_changed,
+                           diff.keywords_changed, diff.mmap_targets_changed, diff.geometry_changed, diff.presentation_changed, diff.texture_cache_budget_changed,
+                           diff.renderer_changed, diff.font_family_changed);
+
+            if (diff.presentation_changed) {
+                first_entry_only_count = extract_config_values("first_entry_only", first_entry_only_array, SINGLE_CONFIG_VALUE_SIZE, &config);
                 first_entry_only_setting = parse_single_user_value_bool(first_entry_only_array, first_entry_only_count, default_show_first_entry_only);
-                trim_out_keywords_count = extract_config_values("trim_out_keywords", trim_out_keywords_array, SINGLE_CONFIG_VALUE_SIZE, conf_file_lines_array, conf_file_line_count);
+                trim_out_keywords_count = extract_config_values("trim_out_keywords", trim_out_keywords_array, SINGLE_CONFIG_VALUE_SIZE, &config);
                 trim_out_keywords_setting = parse_single_user_value_bool(trim_out_keywords_array, trim_out_keywords_count, default_trim_out_keywords);
+                window_should_render = true;
             }
 
-            DEBUG_SHOW_LOC("Read target paths from config file\n");
-            matching_lines_curr_line_index = 0;
-            for (size_t i = 0; i < target_paths_count; i++) {
-                DEBUG_PRINTF(YEL "%zu: %s" RESET "\n", i + 1, target_paths_array[i]);
-                keyword_lines_into_array(target_paths_array[i], matching_lines_array, &matching_lines_curr_line_index, MAX_MATCHING_LINES_CAPACITY, keywords_array, keywords_count);
+            if (diff.geometry_changed) {
+                window_width_count = extract_config_values("initial_window_width", window_width_array, SINGLE_CONFIG_VALUE_SIZE, &config);
+                window_height_count = extract_config_values("initial_window_height", window_height_array, SINGLE_CONFIG_VALUE_SIZE, &config);
+                window_x_position_count = extract_config_values("initial_window_x", window_x_position_array, SINGLE_CONFIG_VALUE_SIZE, &config);
+                window_y_position_count = extract_config_values("initial_window_y", window_y_position_array, SINGLE_CONFIG_VALUE_SIZE, &config);
+                window_width = parse_single_user_value_int(window_width_array, window_width_count, default_window_width);
+                window_height = parse_single_user_value_int(window_height_array, window_height_count, default_window_height);
+                window_position_x = centered_window_x_position(user_display_mode_info.w, window_width); // same as at startup
+                window_position_y = parse_single_user_value_int(window_y_position_array, window_y_position_count, default_window_y_position);
+                SDL_SetWindowSize(window_ptr, window_width, window_height);
+                SDL_SetWindowPosition(window_ptr, window_position_x, window_position_y);
+                window_should_render = true;
             }
-        } else if (target_paths_modified(target_paths_array, target_paths_count, &target_paths_last_mtime, target_path_nonexistence_array) != 0) {
-            window_should_render = true;
-            DEBUG_SHOW_LOC("Read target paths from config file\n");
-            matching_lines_curr_line_index = 0;
-            for (size_t i = 0; i < target_paths_count; i++) {
-                DEBUG_PRINTF(YEL "%zu: %s" RESET "\n", i + 1, target_paths_array[i]);
-                keyword_lines_into_array(target_paths_array[i], matching_lines_array, &matching_lines_curr_line_index, MAX_MATCHING_LINES_CAPACITY, keywords_array, keywords_count);
+
+            if (diff.texture_cache_budget_changed) {
+                texture_cache_budget_count = extract_config_values("texture_cache_budget_mb", texture_cache_budget_array, SINGLE_CONFIG_VALUE_SIZE, &config);
+                texture_cache_budget_mb = parse_single_user_value_int(texture_cache_budget_array, texture_cache_budget_count, DEFAULT_TEXTURE_CACHE_BUDGET_MB);
+                text_texture_cache_set_budget(&text_texture_cache, (size_t)SDL_max(texture_cache_budget_mb, 0) * 1024 * 1024);
+            }
+
+            // textures belong to their renderer, so switching backends starts the cache over
+            if (diff.renderer_changed) {
+                renderer_count = extract_config_values("renderer", renderer_array, SINGLE_CONFIG_VALUE_SIZE, &config);
+                RendererPreference new_renderer_preference = parse_renderer_preference(renderer_array, renderer_count);
+                if (new_renderer_preference != renderer_preference) {
+                    renderer_preference = new_renderer_preference;
+                    text_texture_cache_destroy(&text_texture_cache);
+                    SDL_DestroyRenderer(renderer_ptr);
+                    renderer_ptr = create_renderer(window_ptr, renderer_preference);
+                    text_texture_cache_init(&text_texture_cache, renderer_ptr, (size_t)SDL_max(texture_cache_budget_mb, 0) * 1024 * 1024);
+                    window_should_render = true;
+                }
+            }
+
+            // the font is swapped once the resolver is done, see font_resolved below
+            if (diff.font_family_changed) {
+                font_family_count = extract_config_values("font_family", font_family_array, SINGLE_CONFIG_VALUE_SIZE, &config);
+                if (font_family_count > 0) {
+                    font_resolver_request(&font_resolver, font_family_array[0]);
+                }
+            }
+
+            bool rescan_all = reload_requested || diff.keywords_changed || diff.mmap_targets_changed;
+            if (diff.targets_changed) {
+                target_paths_count = extract_config_values("file", target_paths_array, MAX_TARGET_PATHS, &config);
+                DEBUG_SHOW_LOC("Read target paths from config file\n");
+                for (size_t i = 0; i < target_paths_count; i++) {
+                    DEBUG_PRINTF(YEL "%zu: %s" RESET "\n", i + 1, target_paths_array[i]);
+                }
+
+                SDL_LockMutex(file_watch_args.watcher_mutex);
+                conf_file_watch_id = watch_config_and_targets(&watcher, conf_file_path, target_paths_array, target_paths_count);
+                SDL_UnlockMutex(file_watch_args.watcher_mutex);
+                fwWakeup(&watcher); // let the thread re-evaluate its poll timeout
+            }
+            if (rescan_all || diff.targets_changed) {
+                keywords_count = extract_config_values("keyword", keywords_array, MAX_KEYWORDS, &config);
+                mmap_targets_count = extract_config_values("mmap_targets", mmap_targets_array, SINGLE_CONFIG_VALUE_SIZE, &config);
+                mmap_targets_setting = parse_single_user_value_bool(mmap_targets_array, mmap_targets_count, default_mmap_targets);
+                scan_thread_request_reconfigure(&scan_thread, target_paths_array, target_paths_count, keywords_array, keywords_count, mmap_targets_setting, rescan_all);
+            }
+            trEnd("reload_config", reload_traced, NULL);
+        }
+
+        if (font_resolved) {
+            font_resolved = false;
+            char family_name[MAX_STRING_LENGTH_CAPACITY];
+            char new_font_path[MAX_STRING_LENGTH_CAPACITY];
+            bool found;
+            if (!font_resolver_take_result(&font_resolver, family_name, new_font_path, sizeof(new_font_path), &found)) {
+                // nothing new, or a newer request is in flight
+            } else if (!found) {
+                fprintf(stderr, "No installed font has the family \"%s\", keeping %s\n", family_name, font_path);
+            } else if (strcmp(new_font_path, font_path) != 0) {
+                TTF_Font* new_font_ptr = TTF_OpenFont(new_font_path, font_size);
+                if (new_font_ptr) {
+                    text_texture_cache_forget_font(&text_texture_cache, font_ptr);
+                    TTF_CloseFont(font_ptr);
+                    font_ptr = new_font_ptr;
+                    snprintf(font_path, sizeof(font_path), "%s", new_font_path);
+                    window_should_render = true;
+                } else {
+                    fprintf(stderr, "Couldn't load %s: %s\n", new_font_path, TTF_GetError());
+                }
             }
         }
+
+        // the previous entries stay on screen until the scan thread is done
+        if (scan_results_ready) {
+            scan_results_ready = false;
+            if (scan_thread_take_snapshot(&scan_thread, &entry_snapshot)) {
+                window_should_render = true;
+            }
+        }
+
+        perf_hud_count_wakeup(&perf_hud, !window_should_render);
+        if (perf_hud_refresh_due(&perf_hud)) {
+            window_should_render = true;
+        }
+    }
+
+    free(entry_text_buffer);
+    if (present_log) {
+        fclose(present_log);
     }
+    DEBUG_SHOW_LOC("Stopping scan thread\n");
+    scan_thread_stop(&scan_thread);
+    if (metrics_served) {
+        metrics_server_stop(&metrics_server);
+    }
+    diagnostics_destroy(&diagnostics);
+
+    DEBUG_SHOW_LOC("Stopping file watch thread\n");
+    SDL_AtomicSet(&file_watch_args.should_run, 0);
+    fwWakeup(&watcher);
+    SDL_WaitThread(file_watch_thread_ptr, NULL);
+    SDL_DestroyMutex(file_watch_args.watcher_mutex);
+    fwDestroy(&watcher);
+    font_resolver_stop(&font_resolver);
+    worker_pool_destroy(&font_pool);
 
     DEBUG_SHOW_LOC("Destroying Renderer\n");
+    text_texture_cache_destroy(&text_texture_cache);
     SDL_DestroyRenderer(renderer_ptr);
 
     DEBUG_SHOW_LOC("Destroying Window\n");
@@ -1097,14 +3208,26 @@ int main(int argc __attribute__((unused)), char* argv[] __attribute__((unused)))
     DEBUG_SHOW_LOC("Quitting SDL\n");
     SDL_Quit();
 
-    destroy_string_array(conf_file_lines_array, MAX_LINES_IN_CONFIG_FILE);
-    destroy_string_array(matching_lines_array, MAX_LINES_IN_CONFIG_FILE);
+    cfDestroy(&config);
+    cfDestroy(&previous_config);
     destroy_string_array(target_paths_array, MAX_TARGET_PATHS);
     destroy_string_array(keywords_array, MAX_KEYWORDS);
     destroy_string_array(window_height_array, SINGLE_CONFIG_VALUE_SIZE);
     destroy_string_array(window_width_array, SINGLE_CONFIG_VALUE_SIZE);
     destroy_string_array(window_x_position_array, SINGLE_CONFIG_VALUE_SIZE);
     destroy_string_array(window_y_position_array, SINGLE_CONFIG_VALUE_SIZE);
+    destroy_string_array(mmap_targets_array, SINGLE_CONFIG_VALUE_SIZE);
+    destroy_string_array(texture_cache_budget_array, SINGLE_CONFIG_VALUE_SIZE);
+    destroy_string_array(renderer_array, SINGLE_CONFIG_VALUE_SIZE);
+    destroy_string_array(font_family_array, SINGLE_CONFIG_VALUE_SIZE);
+
+    // every other thread has stopped by now
+    if (trEnabled()) {
+        if (!trWrite()) {
+            fprintf(stderr, "Couldn't write the trace to %s=%s\n", TRACE_ENV_VAR, getenv(TRACE_ENV_VAR));
+        }
+        trShutdown();
+    }
 
     DEBUG_SHOW_LOC("Exiting Application\n");
 
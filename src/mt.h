@@ -0,0 +1,220 @@
+// clang-format Language: C
+#ifndef MT_H_
+#define MT_H_
+
+#define MT_MAX_BUCKETS 16
+#define MT_REQUEST_TIMEOUT_MS 100
+#define MT_SOCKET_PATH_MAX 108 // sun_path on Linux
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+typedef struct MT_Histogram MT_Histogram;
+typedef struct MT_Endpoint MT_Endpoint;
+void mtAdd(_Atomic uint64_t* counter, uint64_t amount);
+void mtSet(_Atomic uint64_t* gauge, uint64_t value);
+void mtHistogramInit(MT_Histogram* histogram, const double* bounds, size_t bound_count);
+void mtObserve(MT_Histogram* histogram, uint64_t ns);
+void mtWriteCounter(FILE* out, const char* name, const char* help, uint64_t value);
+void mtWriteGauge(FILE* out, const char* name, const char* help, double value);
+void mtWriteHistogram(FILE* out, const char* name, const char* help, const MT_Histogram* histogram);
+bool mtEndpointOpen(MT_Endpoint* endpoint, const char* socket_path);
+int mtEndpointWait(MT_Endpoint* endpoint, int timeout_ms);
+void mtEndpointServe(int client_fd, const char* text, size_t length);
+void mtEndpointWakeup(MT_Endpoint* endpoint);
+void mtEndpointClose(MT_Endpoint* endpoint);
+
+// Implementation:
+
+#ifndef _WIN32
+    #include <fcntl.h>
+    #include <poll.h>
+    #include <sys/socket.h>
+    #include <sys/un.h>
+    #include <unistd.h>
+    #ifndef MSG_NOSIGNAL
+        #define MSG_NOSIGNAL 0
+    #endif
+#endif
+
+// Durations in buckets by upper bound (in seconds, ascending), plus their sum.
+// Observing is one relaxed atomic add per field, so any thread can observe
+// without a lock; a reader may see a count without its sum yet, which
+// Prometheus tolerates.
+typedef struct MT_Histogram {
+    const double* bounds;
+    size_t bound_count;
+    _Atomic uint64_t counts[MT_MAX_BUCKETS + 1]; // per bucket, not cumulative; the last one is +Inf
+    _Atomic uint64_t sum_ns;
+} MT_Histogram;
+
+void mtAdd(_Atomic uint64_t* counter, uint64_t amount) {
+    atomic_fetch_add_explicit(counter, amount, memory_order_relaxed);
+}
+
+void mtSet(_Atomic uint64_t* gauge, uint64_t value) {
+    atomic_store_explicit(gauge, value, memory_order_relaxed);
+}
+
+void mtHistogramInit(MT_Histogram* histogram, const double* bounds, size_t bound_count) {
+    memset(histogram, 0, sizeof(*histogram));
+    histogram->bounds = bounds;
+    histogram->bound_count = bound_count < MT_MAX_BUCKETS ? bound_count : MT_MAX_BUCKETS;
+}
+
+void mtObserve(MT_Histogram* histogram, uint64_t ns) {
+    double seconds = ns / 1e9;
+    size_t bucket = 0;
+    while (bucket < histogram->bound_count && seconds > histogram->bounds[bucket])
+        bucket++;
+    atomic_fetch_add_explicit(&histogram->counts[bucket], 1, memory_order_relaxed);
+    atomic_fetch_add_explicit(&histogram->sum_ns, ns, memory_order_relaxed);
+}
+
+// Prometheus text exposition format, one metric at a time.
+
+void mtWriteCounter(FILE* out, const char* name, const char* help, uint64_t value) {
+    fprintf(out, "# HELP %s %s\n# TYPE %s counter\n%s %llu\n", name, help, name, name, (unsigned long long)value);
+}
+
+void mtWriteGauge(FILE* out, const char* name, const char* help, double value) {
+    fprintf(out, "# HELP %s %s\n# TYPE %s gauge\n%s %.17g\n", name, help, name, name, value);
+}
+
+void mtWriteHistogram(FILE* out, const char* name, const char* help, const MT_Histogram* histogram) {
+    fprintf(out, "# HELP %s %s\n# TYPE %s histogram\n", name, help, name);
+    uint64_t cumulative = 0;
+    for (size_t i = 0; i < histogram->bound_count; i++) {
+        cumulative += atomic_load_explicit(&histogram->counts[i], memory_order_relaxed);
+        fprintf(out, "%s_bucket{le=\"%g\"} %llu\n", name, histogram->bounds[i], (unsigned long long)cumulative);
+    }
+    cumulative += atomic_load_explicit(&histogram->counts[histogram->bound_count], memory_order_relaxed);
+    fprintf(out, "%s_bucket{le=\"+Inf\"} %llu\n", name, (unsigned long long)cumulative);
+    fprintf(out, "%s_sum %.9f\n", name, atomic_load_explicit(&histogram->sum_ns, memory_order_relaxed) / 1e9);
+    fprintf(out, "%s_count %llu\n", name, (unsigned long long)cumulative);
+}
+
+// Where the metrics are served from: a Unix domain socket (when given a path)
+// and a self-pipe to interrupt mtEndpointWait(). Not available on Windows.
+typedef struct MT_Endpoint {
+    int listen_fd; // -1 without a socket
+    int wake_fds[2];
+    char socket_path[MT_SOCKET_PATH_MAX];
+} MT_Endpoint;
+
+// Listen on socket_path (replacing a stale socket left there), or only set up
+// the wakeup pipe for a NULL path. Returns false if that fails.
+bool mtEndpointOpen(MT_Endpoint* endpoint, const char* socket_path) {
+    endpoint->listen_fd = -1;
+    endpoint->wake_fds[0] = endpoint->wake_fds[1] = -1;
+    endpoint->socket_path[0] = '\0';
+#ifndef _WIN32
+    if (pipe(endpoint->wake_fds) != 0)
+        return false;
+    fcntl(endpoint->wake_fds[0], F_SETFL, O_NONBLOCK);
+    fcntl(endpoint->wake_fds[1], F_SETFL, O_NONBLOCK);
+    if (!socket_path)
+        return true;
+
+    struct sockaddr_un address;
+    memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    if (strlen(socket_path) >= sizeof(address.sun_path))
+        return false;
+    memcpy(address.sun_path, socket_path, strlen(socket_path) + 1);
+    endpoint->listen_fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (endpoint->listen_fd < 0)
+        return false;
+    fcntl(endpoint->listen_fd, F_SETFD, FD_CLOEXEC);
+    unlink(socket_path);
+    if (bind(endpoint->listen_fd, (struct sockaddr*)&address, sizeof(address)) != 0 || listen(endpoint->listen_fd, 8) != 0) {
+        close(endpoint->listen_fd);
+        endpoint->listen_fd = -1;
+        return false;
+    }
+    snprintf(endpoint->socket_path, sizeof(endpoint->socket_path), "%s", socket_path);
+    return true;
+#else
+    (void)socket_path;
+    return false;
+#endif
+}
+
+// Block until a client connects, mtEndpointWakeup() is called or timeout_ms
+// passes (-1 waits forever). Returns the client's fd, or -1.
+int mtEndpointWait(MT_Endpoint* endpoint, int timeout_ms) {
+#ifndef _WIN32
+    struct pollfd fds[2] = {{endpoint->wake_fds[0], POLLIN, 0}, {endpoint->listen_fd, POLLIN, 0}};
+    poll(fds, endpoint->listen_fd >= 0 ? 2 : 1, timeout_ms);
+
+    char drain[64];
+    while (read(endpoint->wake_fds[0], drain, sizeof(drain)) > 0) {
+    }
+    if (endpoint->listen_fd >= 0 && (fds[1].revents & POLLIN))
+        return accept(endpoint->listen_fd, NULL, NULL);
+#else
+    (void)endpoint, (void)timeout_ms;
+#endif
+    return -1;
+}
+
+// Send text to a client and hang up. Clients that send an HTTP request (like
+// `curl --unix-socket`) within MT_REQUEST_TIMEOUT_MS get an HTTP response,
+// the others (`socat - UNIX-CONNECT:...`) just the text.
+void mtEndpointServe(int client_fd, const char* text, size_t length) {
+#ifndef _WIN32
+    char request[512];
+    ssize_t request_length = 0;
+    struct pollfd client = {client_fd, POLLIN, 0};
+    if (poll(&client, 1, MT_REQUEST_TIMEOUT_MS) > 0)
+        request_length = recv(client_fd, request, sizeof(request), 0);
+    if (request_length >= 4 && memcmp(request, "GET ", 4) == 0) {
+        char header[160];
+        int header_length = snprintf(header, sizeof(header), "HTTP/1.0 200 OK\r\nContent-Type: text/plain; version=0.0.4\r\nContent-Length: %zu\r\n\r\n", length);
+        send(client_fd, header, header_length, MSG_NOSIGNAL);
+    }
+    while (length > 0) {
+        ssize_t sent = send(client_fd, text, length, MSG_NOSIGNAL);
+        if (sent <= 0)
+            break;
+        text += sent;
+        length -= sent;
+    }
+    close(client_fd);
+#else
+    (void)client_fd, (void)text, (void)length;
+#endif
+}
+
+void mtEndpointWakeup(MT_Endpoint* endpoint) {
+#ifndef _WIN32
+    char byte = 1;
+    if (endpoint->wake_fds[1] >= 0 && write(endpoint->wake_fds[1], &byte, 1) < 0) {
+        // pipe full: a wakeup is already pending
+    }
+#else
+    (void)endpoint;
+#endif
+}
+
+// Stop listening and remove the socket file.
+void mtEndpointClose(MT_Endpoint* endpoint) {
+#ifndef _WIN32
+    if (endpoint->listen_fd >= 0) {
+        close(endpoint->listen_fd);
+        unlink(endpoint->socket_path);
+    }
+    for (int i = 0; i < 2; i++) {
+        if (endpoint->wake_fds[i] >= 0)
+            close(endpoint->wake_fds[i]);
+    }
+#endif
+    endpoint->listen_fd = -1;
+    endpoint->wake_fds[0] = endpoint->wake_fds[1] = -1;
+}
+
+#endif // MT_H_
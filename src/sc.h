@@ -0,0 +1,255 @@
+// clang-format Language: C
+#ifndef SC_H_
+#define SC_H_
+
+#include <errno.h>
+#include <stdalign.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "ac.h"
+#include "ar.h"
+#include "cf.h"
+#include "ks.h"
+
+typedef struct SC_MatchSpan SC_MatchSpan;
+typedef struct SC_MatchStore SC_MatchStore;
+void scMatchStoreInit(SC_MatchStore* store);
+void scMatchStoreDestroy(SC_MatchStore* store);
+void scMatchStoreReserve(SC_MatchStore* store, size_t min_capacity);
+SC_MatchSpan* scMatchStorePush(SC_MatchStore* store);
+
+typedef struct SC_FileMatches SC_FileMatches;
+SC_FileMatches* scFileMatchesCreate(void);
+void scFileMatchesRetain(SC_FileMatches* file_matches);
+void scFileMatchesRelease(SC_FileMatches* file_matches);
+
+typedef struct SC_KeywordMatcher SC_KeywordMatcher;
+void scKeywordMatcherCompile(SC_KeywordMatcher* matcher, char** keywords, size_t keyword_count);
+void scKeywordMatcherDestroy(SC_KeywordMatcher* matcher);
+
+typedef struct SC_Cancellation SC_Cancellation;
+bool scCancelled(const SC_Cancellation* cancellation);
+
+typedef enum { SC_SCAN_DONE, SC_SCAN_LOAD_FAILED, SC_SCAN_INTERRUPTED } SC_ScanStatus;
+SC_ScanStatus scScanFile(const char* path, size_t file_id, const SC_KeywordMatcher* matcher, bool use_mmap, const SC_Cancellation* cancellation, SC_FileMatches* out);
+const SC_MatchSpan** scIndexMatches(AR_Arena* arena, SC_FileMatches* const* files, size_t file_count, size_t* span_count);
+
+size_t scConfigValues(const CF_Config* config, const char* key, char** values, size_t value_count, size_t value_capacity);
+
+// Every key a config file may set, the others are reported as unknown.
+static const char* const scConfigKeys[] = {
+    "file", "keyword", "initial_window_width", "initial_window_height", "initial_window_x", "initial_window_y", "first_entry_only",
+    "trim_out_keywords", "mmap_targets", "texture_cache_budget_mb", "renderer", "font_family",
+};
+#define SC_CONFIG_KEY_COUNT (sizeof(scConfigKeys) / sizeof(scConfigKeys[0]))
+
+// Implementation:
+
+// The scan path main.c runs on every rescan, from loading a target file to the
+// index of its matching lines, and the config lookups of a reload. Nothing in
+// here depends on SDL, so bench/scan_bench.c measures this same code.
+
+// A matching line: where it sits in its file, and its text. The text points
+// into the file's mapping, or into a packed copy in a SC_MatchStore arena.
+typedef struct SC_MatchSpan {
+    size_t file_id; // index into the caller's list of files
+    size_t offset;
+    size_t length;
+    const char* text; // not NUL terminated, length bytes
+    int keyword_id;   // index into the configured keywords
+    size_t line_number;
+} SC_MatchSpan;
+
+// Growable list of matches backed by an arena, so there is no per-line
+// malloc/free and no limit on count or line length.
+typedef struct SC_MatchStore {
+    AR_Arena arena;
+    SC_MatchSpan* spans;
+    size_t span_count;
+    size_t span_capacity;
+} SC_MatchStore;
+
+void scMatchStoreInit(SC_MatchStore* store) {
+    memset(store, 0, sizeof(*store));
+    arInit(&store->arena);
+}
+
+void scMatchStoreDestroy(SC_MatchStore* store) {
+    arDestroy(&store->arena);
+    store->spans = NULL;
+    store->span_count = 0;
+    store->span_capacity = 0;
+}
+
+// Make room for min_capacity spans.
+void scMatchStoreReserve(SC_MatchStore* store, size_t min_capacity) {
+    if (store->span_capacity >= min_capacity)
+        return;
+    size_t new_capacity = store->span_capacity ? store->span_capacity * 2 : 16;
+    while (new_capacity < min_capacity)
+        new_capacity *= 2;
+    store->spans = arGrowArray(&store->arena, store->spans, store->span_capacity * sizeof(SC_MatchSpan), new_capacity * sizeof(SC_MatchSpan), alignof(SC_MatchSpan));
+    store->span_capacity = new_capacity;
+}
+
+SC_MatchSpan* scMatchStorePush(SC_MatchStore* store) {
+    scMatchStoreReserve(store, store->span_count + 1);
+    return &store->spans[store->span_count++];
+}
+
+// The matching lines found by one scan of one file, refcounted so that every
+// list of entries showing them can share them instead of copying. A mapped
+// file stays mapped while its spans are in use; a file read into memory is
+// released right after the scan, once its matching lines are packed into the
+// store.
+typedef struct SC_FileMatches {
+    atomic_int refcount;
+    KS_FileData file_data;
+    size_t bytes_read; // 0 until the file is loaded
+    int load_error;    // errno when scScanFile() couldn't load the file
+    SC_MatchStore matches;
+} SC_FileMatches;
+
+SC_FileMatches* scFileMatchesCreate(void) {
+    SC_FileMatches* file_matches = calloc(1, sizeof(SC_FileMatches));
+    if (!file_matches)
+        abort();
+    atomic_init(&file_matches->refcount, 1);
+    scMatchStoreInit(&file_matches->matches);
+    return file_matches;
+}
+
+void scFileMatchesRetain(SC_FileMatches* file_matches) {
+    atomic_fetch_add_explicit(&file_matches->refcount, 1, memory_order_relaxed);
+}
+
+// Unmaps the file and frees the spans once nothing refers to them anymore.
+void scFileMatchesRelease(SC_FileMatches* file_matches) {
+    if (file_matches && atomic_fetch_sub_explicit(&file_matches->refcount, 1, memory_order_acq_rel) == 1) {
+        ksReleaseFile(&file_matches->file_data);
+        scMatchStoreDestroy(&file_matches->matches);
+        free(file_matches);
+    }
+}
+
+// The prefilter cheaply picks lines that could hold a keyword, the automaton
+// then confirms them and tells which keyword matched.
+typedef struct SC_KeywordMatcher {
+    KS_Prefilter prefilter;
+    AC_Automaton automaton;
+} SC_KeywordMatcher;
+
+// Keyword ids are indices into keywords.
+void scKeywordMatcherCompile(SC_KeywordMatcher* matcher, char** keywords, size_t keyword_count) {
+    ksPrefilterInit(&matcher->prefilter);
+    acInit(&matcher->automaton);
+    for (size_t i = 0; i < keyword_count; i++) {
+        ksPrefilterAddKeyword(&matcher->prefilter, keywords[i]);
+        acAddKeyword(&matcher->automaton, keywords[i], (int)i);
+    }
+    ksPrefilterCompile(&matcher->prefilter);
+    acCompile(&matcher->automaton);
+}
+
+void scKeywordMatcherDestroy(SC_KeywordMatcher* matcher) {
+    acDestroy(&matcher->automaton);
+}
+
+// A scan gives up once generation moves past expected_generation, that is
+// once a newer scan has been requested.
+typedef struct SC_Cancellation {
+    atomic_int* generation;
+    int expected_generation;
+} SC_Cancellation;
+
+bool scCancelled(const SC_Cancellation* cancellation) {
+    return cancellation && atomic_load_explicit(cancellation->generation, memory_order_relaxed) != cancellation->expected_generation;
+}
+
+typedef struct {
+    SC_FileMatches* out;
+    size_t file_id;
+    const SC_KeywordMatcher* matcher;
+    const SC_Cancellation* cancellation;
+    bool interrupted;
+} SC_LineScan;
+
+static bool scLineCandidate(const char* line, size_t line_length, size_t line_number, void* user) {
+    SC_LineScan* scan = (SC_LineScan*)user;
+    if (scCancelled(scan->cancellation)) {
+        scan->interrupted = true;
+        return false;
+    }
+
+    int keyword_id = acFind(&scan->matcher->automaton, line, line_length, NULL);
+    if (keyword_id >= 0) {
+        SC_FileMatches* out = scan->out;
+        SC_MatchSpan* span = scMatchStorePush(&out->matches);
+        span->file_id = scan->file_id;
+        span->offset = line - out->file_data.data;
+        span->length = line_length;
+        span->text = out->file_data.mapped ? line : arStrndup(&out->matches.arena, line, line_length);
+        span->keyword_id = keyword_id;
+        span->line_number = line_number;
+    }
+    return true;
+}
+
+// Find the lines of path that hold a keyword and add them to out, which should
+// be fresh from scFileMatchesCreate(). Safe to run on several threads at once,
+// each with its own out.
+SC_ScanStatus scScanFile(const char* path, size_t file_id, const SC_KeywordMatcher* matcher, bool use_mmap, const SC_Cancellation* cancellation, SC_FileMatches* out) {
+    if (scCancelled(cancellation))
+        return SC_SCAN_INTERRUPTED;
+    if (!ksLoadFile(path, use_mmap, &out->file_data)) {
+        out->load_error = errno;
+        return SC_SCAN_LOAD_FAILED;
+    }
+    out->bytes_read = out->file_data.size;
+
+    // Search for the keywords, only in lines that pass the prefilter
+    SC_LineScan scan = {out, file_id, matcher, cancellation, false};
+    ksScanLines(&matcher->prefilter, out->file_data.data, out->file_data.size, scLineCandidate, &scan);
+
+    if (!out->file_data.mapped) // the matching lines were copied out
+        ksReleaseFile(&out->file_data);
+    return scan.interrupted ? SC_SCAN_INTERRUPTED : SC_SCAN_DONE;
+}
+
+// Flat list of the spans of files, in order, allocated from arena. Only the
+// index is built, the spans stay in the files' stores.
+const SC_MatchSpan** scIndexMatches(AR_Arena* arena, SC_FileMatches* const* files, size_t file_count, size_t* span_count) {
+    size_t total_span_count = 0;
+    for (size_t i = 0; i < file_count; i++)
+        total_span_count += files[i]->matches.span_count;
+
+    const SC_MatchSpan** spans = arAlloc(arena, (total_span_count ? total_span_count : 1) * sizeof(SC_MatchSpan*), alignof(SC_MatchSpan*));
+    *span_count = 0;
+    for (size_t i = 0; i < file_count; i++) {
+        const SC_MatchStore* matches = &files[i]->matches;
+        for (size_t j = 0; j < matches->span_count; j++)
+            spans[(*span_count)++] = &matches->spans[j];
+    }
+    return spans;
+}
+
+// Copy the values of key into values (value_count strings of value_capacity
+// bytes each). Returns how many were copied; values that don't fit are
+// dropped with a warning.
+size_t scConfigValues(const CF_Config* config, const char* key, char** values, size_t value_count, size_t value_capacity) {
+    size_t count = cfCount(config, key);
+    if (count > value_count) {
+        fprintf(stderr, "Warning: only the first %zu '%s' entries of the config are used\n", value_count, key);
+        count = value_count;
+    }
+    for (size_t i = 0; i < count; i++)
+        snprintf(values[i], value_capacity, "%s", cfGet(config, key, i));
+    return count;
+}
+
+#endif // SC_H_
@@ -0,0 +1,224 @@
+// clang-format Language: C
+#ifndef SI_H_
+#define SI_H_
+
+#define SI_TRIGRAM_BUCKETS 4096
+#define SI_MAX_QUERY 256
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+typedef struct SI_Index SI_Index;
+void siInit(SI_Index* index);
+uint32_t siAdd(SI_Index* index, const char* text);
+size_t siCount(const SI_Index* index);
+const char* siLowered(const SI_Index* index, uint32_t id);
+void siDestroy(SI_Index* index);
+
+typedef struct SI_Filter SI_Filter;
+void siFilterInit(SI_Filter* filter);
+void siFilterSetQuery(SI_Filter* filter, const SI_Index* index, const char* query);
+void siFilterUpdate(SI_Filter* filter, const SI_Index* index);
+void siFilterDestroy(SI_Filter* filter);
+
+// Implementation:
+
+typedef struct {
+    uint32_t* ids; // ascending
+    uint32_t size;
+    uint32_t capacity;
+} SI_Postings;
+
+// Case-insensitive (ASCII) substring index over a growing list of strings.
+// Every string is kept lowercased in one buffer, and each of its trigrams
+// (hashed into SI_TRIGRAM_BUCKETS) lists the string, so a query of three or
+// more bytes only has to check the strings in its rarest trigram's list.
+typedef struct SI_Index {
+    char* text; // lowercased strings, NUL separated
+    size_t text_size;
+    size_t text_capacity;
+    uint32_t* offsets; // string id -> offset in text
+    size_t count;
+    size_t capacity;
+    SI_Postings trigrams[SI_TRIGRAM_BUCKETS];
+} SI_Index;
+
+// The ids of the strings containing query, in id order. The result follows
+// the index incrementally: a query that extends the previous one only
+// re-checks the current matches, and siFilterUpdate() only looks at strings
+// added since the last call.
+typedef struct SI_Filter {
+    char query[SI_MAX_QUERY]; // lowercased
+    size_t query_length;
+    uint32_t* ids;
+    size_t count;
+    size_t capacity;
+    size_t indexed_count; // strings of the index already filtered
+} SI_Filter;
+
+static char siLower(char ch) {
+    return (ch >= 'A' && ch <= 'Z') ? (char)(ch - 'A' + 'a') : ch;
+}
+
+static uint32_t siTrigramBucket(const char* trigram) {
+    uint32_t key = (uint32_t)(unsigned char)trigram[0] | (uint32_t)(unsigned char)trigram[1] << 8 | (uint32_t)(unsigned char)trigram[2] << 16;
+    return (key * 2654435761u) >> 20; // top 12 bits
+}
+
+void siInit(SI_Index* index) {
+    memset(index, 0, sizeof(*index));
+}
+
+uint32_t siAdd(SI_Index* index, const char* text) {
+    size_t length = strlen(text);
+    if (index->text_capacity < index->text_size + length + 1) {
+        size_t newCap = index->text_capacity ? index->text_capacity : 4096;
+        while (newCap < index->text_size + length + 1)
+            newCap *= 2;
+        char* tmp = realloc(index->text, newCap);
+        if (!tmp)
+            abort();
+        index->text = tmp;
+        index->text_capacity = newCap;
+    }
+    if (index->capacity < index->count + 1) {
+        size_t newCap = index->capacity ? index->capacity * 2 : 256;
+        uint32_t* tmp = realloc(index->offsets, newCap * sizeof(uint32_t));
+        if (!tmp)
+            abort();
+        index->offsets = tmp;
+        index->capacity = newCap;
+    }
+
+    uint32_t id = (uint32_t)index->count++;
+    char* lowered = index->text + index->text_size;
+    index->offsets[id] = (uint32_t)index->text_size;
+    for (size_t i = 0; i < length; i++)
+        lowered[i] = siLower(text[i]);
+    lowered[length] = '\0';
+    index->text_size += length + 1;
+
+    for (size_t i = 0; i + 3 <= length; i++) {
+        SI_Postings* postings = &index->trigrams[siTrigramBucket(lowered + i)];
+        if (postings->size > 0 && postings->ids[postings->size - 1] == id)
+            continue; // this string is already listed
+        if (postings->capacity < postings->size + 1) {
+            uint32_t newCap = postings->capacity ? postings->capacity * 2 : 8;
+            uint32_t* tmp = realloc(postings->ids, newCap * sizeof(uint32_t));
+            if (!tmp)
+                abort();
+            postings->ids = tmp;
+            postings->capacity = newCap;
+        }
+        postings->ids[postings->size++] = id;
+    }
+    return id;
+}
+
+size_t siCount(const SI_Index* index) {
+    return index->count;
+}
+
+const char* siLowered(const SI_Index* index, uint32_t id) {
+    return index->text + index->offsets[id];
+}
+
+void siDestroy(SI_Index* index) {
+    for (size_t i = 0; i < SI_TRIGRAM_BUCKETS; i++)
+        free(index->trigrams[i].ids);
+    free(index->text);
+    free(index->offsets);
+    memset(index, 0, sizeof(*index));
+}
+
+void siFilterInit(SI_Filter* filter) {
+    memset(filter, 0, sizeof(*filter));
+}
+
+void siFilterDestroy(SI_Filter* filter) {
+    free(filter->ids);
+    memset(filter, 0, sizeof(*filter));
+}
+
+static void siFilterPush(SI_Filter* filter, uint32_t id) {
+    if (filter->capacity < filter->count + 1) {
+        size_t newCap = filter->capacity ? filter->capacity * 2 : 256;
+        uint32_t* tmp = realloc(filter->ids, newCap * sizeof(uint32_t));
+        if (!tmp)
+            abort();
+        filter->ids = tmp;
+        filter->capacity = newCap;
+    }
+    filter->ids[filter->count++] = id;
+}
+
+static int siMatches(const SI_Filter* filter, const SI_Index* index, uint32_t id) {
+    return filter->query_length == 0 || strstr(siLowered(index, id), filter->query) != NULL;
+}
+
+// Check the strings with ids in [begin, end) against the query.
+static void siFilterRange(SI_Filter* filter, const SI_Index* index, uint32_t begin, uint32_t end) {
+    if (filter->query_length < 3) {
+        for (uint32_t id = begin; id < end; id++) {
+            if (siMatches(filter, index, id))
+                siFilterPush(filter, id);
+        }
+        return;
+    }
+
+    const SI_Postings* rarest = NULL;
+    for (size_t i = 0; i + 3 <= filter->query_length; i++) {
+        const SI_Postings* postings = &index->trigrams[siTrigramBucket(filter->query + i)];
+        if (!rarest || postings->size < rarest->size)
+            rarest = postings;
+    }
+    // postings are ascending, skip to begin
+    size_t low = 0, high = rarest->size;
+    while (low < high) {
+        size_t mid = (low + high) / 2;
+        if (rarest->ids[mid] < begin)
+            low = mid + 1;
+        else
+            high = mid;
+    }
+    for (size_t i = low; i < rarest->size && rarest->ids[i] < end; i++) {
+        if (siMatches(filter, index, rarest->ids[i]))
+            siFilterPush(filter, rarest->ids[i]);
+    }
+}
+
+void siFilterSetQuery(SI_Filter* filter, const SI_Index* index, const char* query) {
+    char lowered[SI_MAX_QUERY];
+    size_t length = 0;
+    for (; query[length] && length < SI_MAX_QUERY - 1; length++)
+        lowered[length] = siLower(query[length]);
+    lowered[length] = '\0';
+
+    // every string holding the new query also holds the old one, so only the current matches can still match
+    int narrows = filter->indexed_count > 0 && strstr(lowered, filter->query) != NULL;
+    memcpy(filter->query, lowered, length + 1);
+    filter->query_length = length;
+
+    if (narrows) {
+        size_t kept = 0;
+        for (size_t i = 0; i < filter->count; i++) {
+            if (siMatches(filter, index, filter->ids[i]))
+                filter->ids[kept++] = filter->ids[i];
+        }
+        filter->count = kept;
+    } else {
+        filter->count = 0;
+        siFilterRange(filter, index, 0, (uint32_t)filter->indexed_count);
+    }
+    siFilterUpdate(filter, index);
+}
+
+void siFilterUpdate(SI_Filter* filter, const SI_Index* index) {
+    if (filter->indexed_count < index->count)
+        siFilterRange(filter, index, (uint32_t)filter->indexed_count, (uint32_t)index->count);
+    filter->indexed_count = index->count;
+}
+
+#endif // SI_H_
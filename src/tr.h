@@ -0,0 +1,247 @@
+// clang-format Language: C
+#ifndef TR_H_
+#define TR_H_
+
+#define TR_RING_SIZE 8192 // events kept per thread, a power of two
+#define TR_DETAIL_MAX 64
+#define TR_THREAD_NAME_MAX 32
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+bool trInit(const char* path);
+bool trEnabled(void);
+void trSetThreadName(const char* name);
+void trThreadExit(void);
+uint64_t trBegin(void);
+void trEnd(const char* name, uint64_t begin, const char* detail);
+bool trWrite(void);
+void trShutdown(void);
+
+// Implementation:
+
+#ifdef _WIN32
+    #include <process.h>
+    #include <windows.h>
+#else
+    #include <time.h>
+    #include <unistd.h>
+#endif
+
+typedef struct {
+    const char* name; // a string literal
+    uint64_t begin;   // ns
+    uint64_t duration;
+    char detail[TR_DETAIL_MAX];
+} TR_Event;
+
+// One thread's events. Only the owning thread writes to it, so recording an
+// event is a plain store into the ring plus a release store of head; the
+// writer overwrites its oldest events once the ring is full. When a thread
+// exits (see trThreadExit()) its buffer goes to the next thread that starts
+// recording, which keeps appending to the same track. So the number of
+// buffers stays at the most threads recording at once, however many come
+// and go.
+typedef struct TR_Buffer {
+    struct TR_Buffer* next; // in the list of every thread's buffer
+    _Atomic bool in_use;    // owned by a running thread
+    uint32_t thread_id;
+    char thread_name[TR_THREAD_NAME_MAX];
+    _Atomic uint64_t head; // events ever recorded
+    TR_Event events[TR_RING_SIZE];
+} TR_Buffer;
+
+// Scoped spans (Chrome trace "complete" events) recorded per thread and
+// written as trace-event JSON, for chrome://tracing or Perfetto. Everything
+// is a no-op until trInit() is given a path.
+typedef struct {
+    char* path;
+    _Atomic(TR_Buffer*) buffers; // pushed with a CAS, never removed before trShutdown()
+    _Atomic uint32_t next_thread_id;
+    uint64_t epoch;
+    bool enabled;
+} TR_Tracer;
+
+static TR_Tracer trTracer;
+static _Thread_local TR_Buffer* trThreadBuffer;
+
+static uint64_t trNow(void) {
+#ifdef _WIN32
+    static LARGE_INTEGER frequency;
+    if (frequency.QuadPart == 0)
+        QueryPerformanceFrequency(&frequency);
+    LARGE_INTEGER counter;
+    QueryPerformanceCounter(&counter);
+    return (uint64_t)((double)counter.QuadPart * 1e9 / (double)frequency.QuadPart);
+#else
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000u + (uint64_t)ts.tv_nsec;
+#endif
+}
+
+// Start tracing into path (nothing happens for NULL or ""). Call before other
+// threads start recording.
+bool trInit(const char* path) {
+    if (!path || !*path)
+        return false;
+    trTracer.path = strdup(path);
+    if (!trTracer.path)
+        abort();
+    trTracer.epoch = trNow();
+    trTracer.enabled = true;
+    return true;
+}
+
+bool trEnabled(void) {
+    return trTracer.enabled;
+}
+
+static TR_Buffer* trGetThreadBuffer(void) {
+    if (trThreadBuffer)
+        return trThreadBuffer;
+    for (TR_Buffer* buffer = atomic_load(&trTracer.buffers); buffer; buffer = buffer->next) {
+        bool in_use = false;
+        if (!atomic_load_explicit(&buffer->in_use, memory_order_relaxed) && atomic_compare_exchange_strong(&buffer->in_use, &in_use, true)) {
+            trThreadBuffer = buffer;
+            return buffer;
+        }
+    }
+    TR_Buffer* buffer = calloc(1, sizeof(TR_Buffer));
+    if (!buffer)
+        abort();
+    atomic_init(&buffer->in_use, true);
+    buffer->thread_id = atomic_fetch_add(&trTracer.next_thread_id, 1) + 1;
+    snprintf(buffer->thread_name, sizeof(buffer->thread_name), "thread %u", buffer->thread_id);
+    TR_Buffer* head = atomic_load(&trTracer.buffers);
+    do {
+        buffer->next = head;
+    } while (!atomic_compare_exchange_weak(&trTracer.buffers, &head, buffer));
+    trThreadBuffer = buffer;
+    return buffer;
+}
+
+// Name the calling thread in the trace.
+void trSetThreadName(const char* name) {
+    if (!trTracer.enabled)
+        return;
+    snprintf(trGetThreadBuffer()->thread_name, TR_THREAD_NAME_MAX, "%s", name);
+}
+
+// Give the calling thread's buffer up for reuse. Call it before a thread that
+// may have recorded returns; its events stay until they are overwritten.
+void trThreadExit(void) {
+    if (!trThreadBuffer)
+        return;
+    atomic_store(&trThreadBuffer->in_use, false);
+    trThreadBuffer = NULL;
+}
+
+// Timestamp for trEnd(), 0 when tracing is off.
+uint64_t trBegin(void) {
+    return trTracer.enabled ? trNow() : 0;
+}
+
+// Record a span named name (a string literal) from begin until now. detail,
+// if any, is copied and shown as the span's argument.
+void trEnd(const char* name, uint64_t begin, const char* detail) {
+    if (!trTracer.enabled || begin == 0)
+        return;
+    uint64_t end = trNow();
+    TR_Buffer* buffer = trGetThreadBuffer();
+    uint64_t head = atomic_load_explicit(&buffer->head, memory_order_relaxed);
+    TR_Event* event = &buffer->events[head & (TR_RING_SIZE - 1)];
+    event->name = name;
+    event->begin = begin;
+    event->duration = end - begin;
+    event->detail[0] = '\0';
+    if (detail && snprintf(event->detail, sizeof(event->detail), "%s", detail) >= (int)sizeof(event->detail)) {
+        // don't leave half a UTF-8 sequence at the cut
+        size_t length = sizeof(event->detail) - 1;
+        size_t lead = length;
+        while (lead > 0 && ((unsigned char)event->detail[lead - 1] & 0xc0) == 0x80)
+            lead--;
+        if (lead > 0 && (unsigned char)event->detail[lead - 1] >= 0xc0) {
+            unsigned char first = (unsigned char)event->detail[lead - 1];
+            size_t sequence_length = first >= 0xf0 ? 4 : first >= 0xe0 ? 3 : 2;
+            if (lead - 1 + sequence_length > length)
+                event->detail[lead - 1] = '\0';
+        }
+    }
+    atomic_store_explicit(&buffer->head, head + 1, memory_order_release);
+}
+
+static void trWriteJsonString(FILE* file, const char* text) {
+    fputc('"', file);
+    for (const unsigned char* ch = (const unsigned char*)text; *ch; ch++) {
+        if (*ch == '"' || *ch == '\\')
+            fprintf(file, "\\%c", *ch);
+        else if (*ch < 0x20)
+            fprintf(file, "\\u%04x", *ch);
+        else
+            fputc(*ch, file);
+    }
+    fputc('"', file);
+}
+
+// Write everything recorded so far. Threads may keep recording meanwhile, but
+// events they overwrite while it runs can come out garbled, so call it once
+// they are done.
+bool trWrite(void) {
+    if (!trTracer.enabled)
+        return false;
+    FILE* file = fopen(trTracer.path, "wb");
+    if (!file)
+        return false;
+#ifdef _WIN32
+    int pid = _getpid();
+#else
+    int pid = (int)getpid();
+#endif
+
+    fprintf(file, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+    bool first = true;
+    for (TR_Buffer* buffer = atomic_load(&trTracer.buffers); buffer; buffer = buffer->next) {
+        fprintf(file, "%s{\"ph\":\"M\",\"name\":\"thread_name\",\"pid\":%d,\"tid\":%u,\"args\":{\"name\":", first ? "" : ",\n", pid, buffer->thread_id);
+        trWriteJsonString(file, buffer->thread_name);
+        fprintf(file, "}}");
+        first = false;
+
+        uint64_t head = atomic_load_explicit(&buffer->head, memory_order_acquire);
+        uint64_t start = head > TR_RING_SIZE ? head - TR_RING_SIZE : 0;
+        for (uint64_t i = start; i < head; i++) {
+            const TR_Event* event = &buffer->events[i & (TR_RING_SIZE - 1)];
+            fprintf(file, ",\n{\"ph\":\"X\",\"name\":");
+            trWriteJsonString(file, event->name);
+            fprintf(file, ",\"pid\":%d,\"tid\":%u,\"ts\":%.3f,\"dur\":%.3f", pid, buffer->thread_id, (event->begin - trTracer.epoch) / 1000.0,
+                    event->duration / 1000.0);
+            if (event->detail[0]) {
+                fprintf(file, ",\"args\":{\"detail\":");
+                trWriteJsonString(file, event->detail);
+                fprintf(file, "}");
+            }
+            fprintf(file, "}");
+        }
+    }
+    fprintf(file, "\n]}\n");
+    return fclose(file) == 0;
+}
+
+// Free every buffer. Only once no thread records anymore.
+void trShutdown(void) {
+    TR_Buffer* buffer = atomic_exchange(&trTracer.buffers, NULL);
+    while (buffer) {
+        TR_Buffer* next = buffer->next;
+        free(buffer);
+        buffer = next;
+    }
+    free(trTracer.path);
+    memset(&trTracer, 0, sizeof(trTracer));
+    trThreadBuffer = NULL;
+}
+
+#endif // TR_H_